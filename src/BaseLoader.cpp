@@ -0,0 +1,17 @@
+#include <memory>
+#include "BaseLoader.h"
+
+void loadUserHrc(HRCParser* hrcParser, const String* userHrcPath)
+{
+  if (userHrcPath == nullptr || !userHrcPath->length()) {
+    return;
+  }
+  std::unique_ptr<XmlInputSource> dfis(XmlInputSource::newInstance(userHrcPath->getWChars(), static_cast<XMLCh*>(nullptr)));
+  hrcParser->loadSource(dfis.get());
+}
+
+void loadBase(ParserFactory* pf, const String* catalogPath, const String* userHrcPath)
+{
+  pf->loadCatalog(catalogPath);
+  loadUserHrc(pf->getHRCParser(), userHrcPath);
+}
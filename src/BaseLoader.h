@@ -0,0 +1,17 @@
+#ifndef _BASELOADER_H_
+#define _BASELOADER_H_
+
+#include <colorer/ParserFactory.h>
+
+/** Loads the user hrc file to the database, nothing is done for an empty path.
+    @throw Exception on errors of loading
+*/
+void loadUserHrc(HRCParser* hrcParser, const String* userHrcPath);
+
+/** Loads the catalog and the user hrc file to the parser factory.
+    Used by the threads which build their own database.
+    @throw Exception on errors of loading
+*/
+void loadBase(ParserFactory* pf, const String* catalogPath, const String* userHrcPath);
+
+#endif
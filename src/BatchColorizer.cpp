@@ -0,0 +1,314 @@
+#include "BatchColorizer.h"
+#include <colorer/ParserFactoryException.h>
+#include <colorer/viewer/TextLinesStore.h>
+#include "TokenStream.h"
+#include "BaseLoader.h"
+
+BatchColorizer::BatchColorizer(const String* catalogPath_, const String* userHrcPath_, const String* hrdName_,
+                               OutputFormat format_, colorer::ErrorHandler* eh) :
+  catalogPath(nullptr), userHrcPath(nullptr), hrdName(nullptr), format(format_), errorHandler(eh), syncErrorHandler(eh),
+  nextFile(0), doneCount(0), failedCount(0), doneBytes(0), finishedWorkers(0), threadCount(0), stop(false), error(nullptr), time(0)
+{
+  if (catalogPath_) {
+    catalogPath.reset(new SString(*catalogPath_));
+  }
+  if (userHrcPath_ && userHrcPath_->length()) {
+    userHrcPath.reset(new SString(*userHrcPath_));
+  }
+  if (hrdName_ && hrdName_->length()) {
+    hrdName.reset(new SString(*hrdName_));
+  }
+}
+
+BatchColorizer::~BatchColorizer()
+{
+  stop = true;
+  join();
+}
+
+void BatchColorizer::add(const String &inputFile, const String &outputFile)
+{
+  BatchFile file;
+  file.input.reset(new SString(inputFile));
+  file.output.reset(new SString(outputFile));
+  files.push_back(std::move(file));
+}
+
+void BatchColorizer::start(size_t threads)
+{
+  if (threads > files.size()) {
+    threads = files.size();
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  startTime = std::chrono::steady_clock::now();
+  threadCount = threads;
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back(&BatchColorizer::worker, this);
+  }
+}
+
+bool BatchColorizer::wait(unsigned int timeout_ms)
+{
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (finishedWorkers < workers.size()) {
+    if (std::chrono::steady_clock::now() >= end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  join();
+  return true;
+}
+
+void BatchColorizer::join()
+{
+  for (auto it = workers.begin(); it != workers.end(); ++it) {
+    if (it->joinable()) {
+      it->join();
+    }
+  }
+}
+
+void BatchColorizer::setError(const String* msg)
+{
+  std::lock_guard<std::mutex> guard(errorLock);
+  if (error == nullptr) {
+    error.reset(new SString(*msg));
+  }
+}
+
+void BatchColorizer::worker()
+{
+  try {
+    ParserFactory pf(errorHandler ? &syncErrorHandler : nullptr);
+    loadBase(&pf, catalogPath.get(), userHrcPath.get());
+
+    // HTML takes the colors of the true color style, ANSI - of the console one
+    DString hrdClass = DString(format == OF_HTML ? "rgb" : "console");
+    std::unique_ptr<RegionMapper> mapper;
+    try {
+      mapper.reset(pf.createStyledMapper(&hrdClass, hrdName.get()));
+    } catch (ParserFactoryException &) {
+      mapper.reset(pf.createStyledMapper(&hrdClass, nullptr));
+    }
+
+    while (!stop) {
+      size_t idx = nextFile++;
+      if (idx >= files.size()) {
+        break;
+      }
+      try {
+        doneBytes += colorize(&pf, mapper.get(), files[idx]);
+      } catch (Exception &e) {
+        StringBuffer msg(files[idx].input.get());
+        msg.append(DString(": ")).append(e.getMessage());
+        setError(&msg);
+        failedCount++;
+      } catch (std::exception &e) {
+        StringBuffer msg(files[idx].input.get());
+        msg.append(DString(": ")).append(DString(e.what()));
+        setError(&msg);
+        failedCount++;
+      }
+      doneCount++;
+    }
+  } catch (Exception &e) {
+    setError(e.getMessage());
+    stop = true;
+  } catch (std::exception &e) {
+    // an exception must not leave the thread
+    DString msg(e.what());
+    setError(&msg);
+    stop = true;
+  } catch (...) {
+    DString msg("Unknown error while colorizing files");
+    setError(&msg);
+    stop = true;
+  }
+
+  // the last thread fixes the time
+  if (++finishedWorkers == threadCount) {
+    time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+  }
+}
+
+static unsigned __int64 getFileSize(const String* fileName)
+{
+  WIN32_FILE_ATTRIBUTE_DATA fad;
+  if (!GetFileAttributesExW(fileName->getWChars(), GetFileExInfoStandard, &fad)) {
+    return 0;
+  }
+  return (static_cast<unsigned __int64>(fad.nFileSizeHigh) << 32) | fad.nFileSizeLow;
+}
+
+unsigned __int64 BatchColorizer::colorize(ParserFactory* pf, RegionMapper* mapper, const BatchFile &file)
+{
+  TextLinesStore textLinesStore;
+  // token streams keep the columns of the raw text, as the editor export does
+  textLinesStore.loadFile(file.input.get(), nullptr, format != OF_TOKENS);
+  BaseEditor baseEditor(pf, &textLinesStore);
+  baseEditor.setRegionMapper(mapper);
+  baseEditor.chooseFileType(file.input.get());
+  size_t lines = textLinesStore.getLineCount();
+  baseEditor.lineCountEvent(static_cast<int>(lines));
+
+  if (format == OF_TOKENS) {
+    TokenStreamWriter writer;
+    for (size_t lno = 0; lno < lines; lno++) {
+      LineRegion* lineRegions = baseEditor.getLineRegions(static_cast<int>(lno));
+      String* line = textLinesStore.getLine(lno);
+      writer.addLine(line ? line->length() : 0, lineRegions);
+    }
+    writer.save(file.output.get());
+    return getFileSize(file.input.get());
+  }
+
+  const StyledRegion* def = StyledRegion::cast(mapper->getRegionDefine(DString("def:Text")));
+  std::wstring out;
+  if (format == OF_HTML) {
+    wchar_t head[256];
+    _snwprintf(head, 256, L"<html><head><meta charset=\"utf-8\"></head>\n<body style=\"color:#%06x;background:#%06x\"><pre>\n",
+               def && def->bfore ? def->fore : 0, def && def->bback ? def->back : 0xffffff);
+    head[255] = 0;
+    out.append(head);
+  }
+  for (size_t lno = 0; lno < lines; lno++) {
+    LineRegion* lineRegions = baseEditor.getLineRegions(static_cast<int>(lno));
+    String* line = textLinesStore.getLine(lno);
+    if (format == OF_HTML) {
+      writeHtml(out, line, lineRegions);
+    } else {
+      writeAnsi(out, line, lineRegions, def);
+    }
+  }
+  if (format == OF_HTML) {
+    out.append(L"</pre></body></html>\n");
+  }
+
+  int size = WideCharToMultiByte(CP_UTF8, 0, out.data(), static_cast<int>(out.length()), nullptr, 0, nullptr, nullptr);
+  std::vector<char> utf8(size);
+  if (size) {
+    WideCharToMultiByte(CP_UTF8, 0, out.data(), static_cast<int>(out.length()), utf8.data(), size, nullptr, nullptr);
+  }
+  HANDLE output = CreateFileW(file.output->getWChars(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (output == INVALID_HANDLE_VALUE) {
+    StringBuffer msg("Can't create file: ");
+    msg.append(file.output.get());
+    throw Exception(msg);
+  }
+  DWORD written = 0;
+  bool res = !size || (WriteFile(output, utf8.data(), size, &written, nullptr) && written == static_cast<DWORD>(size));
+  CloseHandle(output);
+  if (!res) {
+    StringBuffer msg("Can't write file: ");
+    msg.append(file.output.get());
+    throw Exception(msg);
+  }
+  return getFileSize(file.input.get());
+}
+
+/** Style of each character of the line, the later regions are nested */
+static void getLineStyles(const String* line, LineRegion* lineRegions, std::vector<const StyledRegion*> &styles)
+{
+  int len = line ? line->length() : 0;
+  styles.assign(len, nullptr);
+  for (LineRegion* l1 = lineRegions; l1; l1 = l1->next) {
+    if (l1->special || l1->start == l1->end || l1->styled() == nullptr) {
+      continue;
+    }
+    int end = (l1->end == -1 || l1->end > len) ? len : l1->end;
+    for (int i = l1->start; i < end; i++) {
+      styles[i] = l1->styled();
+    }
+  }
+}
+
+void BatchColorizer::writeHtml(std::wstring &out, const String* line, LineRegion* lineRegions)
+{
+  std::vector<const StyledRegion*> styles;
+  getLineStyles(line, lineRegions, styles);
+  int len = static_cast<int>(styles.size());
+  for (int start = 0; start < len;) {
+    const StyledRegion* rd = styles[start];
+    int end = start + 1;
+    while (end < len && styles[end] == rd) {
+      end++;
+    }
+    if (rd != nullptr && (rd->bfore || rd->bback || rd->style)) {
+      wchar_t span[128];
+      int pos = _snwprintf(span, 128, L"<span style=\"");
+      if (rd->bfore) {
+        pos += _snwprintf(span + pos, 128 - pos, L"color:#%06x;", rd->fore);
+      }
+      if (rd->bback) {
+        pos += _snwprintf(span + pos, 128 - pos, L"background:#%06x;", rd->back);
+      }
+      if (rd->style & StyledRegion::RD_BOLD) {
+        pos += _snwprintf(span + pos, 128 - pos, L"font-weight:bold;");
+      }
+      if (rd->style & StyledRegion::RD_ITALIC) {
+        pos += _snwprintf(span + pos, 128 - pos, L"font-style:italic;");
+      }
+      if (rd->style & StyledRegion::RD_UNDERLINE) {
+        pos += _snwprintf(span + pos, 128 - pos, L"text-decoration:underline;");
+      }
+      _snwprintf(span + pos, 128 - pos, L"\">");
+      span[127] = 0;
+      out.append(span);
+    } else {
+      rd = nullptr;
+    }
+    for (int i = start; i < end; i++) {
+      wchar_t c = (*line)[i];
+      if (c == L'<') {
+        out.append(L"&lt;");
+      } else if (c == L'>') {
+        out.append(L"&gt;");
+      } else if (c == L'&') {
+        out.append(L"&amp;");
+      } else {
+        out.push_back(c);
+      }
+    }
+    if (rd != nullptr) {
+      out.append(L"</span>");
+    }
+    start = end;
+  }
+  out.push_back(L'\n');
+}
+
+/** Console color (bits: 1 blue, 2 green, 4 red, 8 bright) to the ANSI color number */
+static int ansiColor(int color)
+{
+  return ((color & 1) << 2) | (color & 2) | ((color & 4) >> 2);
+}
+
+void BatchColorizer::writeAnsi(std::wstring &out, const String* line, LineRegion* lineRegions, const StyledRegion* def)
+{
+  std::vector<const StyledRegion*> styles;
+  getLineStyles(line, lineRegions, styles);
+  int defFore = def && def->bfore ? def->fore : 7;
+  int defBack = def && def->bback ? def->back : 0;
+  int len = static_cast<int>(styles.size());
+  for (int start = 0; start < len;) {
+    const StyledRegion* rd = styles[start];
+    int end = start + 1;
+    while (end < len && styles[end] == rd) {
+      end++;
+    }
+    int fore = rd && rd->bfore ? rd->fore : defFore;
+    int back = rd && rd->bback ? rd->back : defBack;
+    wchar_t sgr[32];
+    _snwprintf(sgr, 32, L"\x1b[%d;%dm", (fore & 8 ? 90 : 30) + ansiColor(fore & 7), (back & 8 ? 100 : 40) + ansiColor(back & 7));
+    sgr[31] = 0;
+    out.append(sgr);
+    for (int i = start; i < end; i++) {
+      out.push_back((*line)[i]);
+    }
+    start = end;
+  }
+  out.append(L"\x1b[0m\n");
+}
@@ -0,0 +1,104 @@
+#ifndef _BATCHCOLORIZER_H_
+#define _BATCHCOLORIZER_H_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <colorer/ParserFactory.h>
+#include <colorer/editor/BaseEditor.h>
+#include "pcolorer.h"
+#include "SyncErrorHandler.h"
+
+/** Colorizes files to HTML, ANSI text or token streams without the editor.
+    Each thread has its own ParserFactory, as HRCParser is not
+    thread safe, and takes the next file from the shared list.
+    Failed files are counted, the first error is kept.
+    @ingroup far_plugin
+*/
+class BatchColorizer
+{
+public:
+  enum OutputFormat { OF_HTML, OF_ANSI, OF_TOKENS };
+
+  /** @param hrdName color style, the default one is used if it isn't found
+  */
+  BatchColorizer(const String* catalogPath, const String* userHrcPath, const String* hrdName, OutputFormat format,
+                 colorer::ErrorHandler* eh);
+  /** Stops colorizing and waits for the threads */
+  ~BatchColorizer();
+
+  void add(const String &inputFile, const String &outputFile);
+  void start(size_t threads);
+  /** Waits for the end of colorizing.
+      @return false if it isn't finished after timeout
+  */
+  bool wait(unsigned int timeout_ms);
+
+  size_t count() const
+  {
+    return files.size();
+  }
+  size_t done() const
+  {
+    return doneCount;
+  }
+  size_t failed() const
+  {
+    return failedCount;
+  }
+  /** Size of the colorized input files */
+  unsigned __int64 bytes() const
+  {
+    return doneBytes;
+  }
+  /** Time from start to the end of the last thread, in milliseconds */
+  double getTime() const
+  {
+    return time;
+  }
+  /** The first error, or nullptr */
+  const String* getError() const
+  {
+    return error.get();
+  }
+
+private:
+  struct BatchFile {
+    std::unique_ptr<SString> input;
+    std::unique_ptr<SString> output;
+  };
+
+  std::unique_ptr<SString> catalogPath;
+  std::unique_ptr<SString> userHrcPath;
+  std::unique_ptr<SString> hrdName;
+  OutputFormat format;
+  colorer::ErrorHandler* errorHandler;
+  SyncErrorHandler syncErrorHandler;
+
+  std::vector<BatchFile> files;
+  std::vector<std::thread> workers;
+  std::atomic<size_t> nextFile;
+  std::atomic<size_t> doneCount;
+  std::atomic<size_t> failedCount;
+  std::atomic<unsigned __int64> doneBytes;
+  std::atomic<size_t> finishedWorkers;
+  size_t threadCount;
+  std::atomic<bool> stop;
+  std::mutex errorLock;
+  std::unique_ptr<SString> error;
+  std::chrono::steady_clock::time_point startTime;
+  double time;
+
+  void worker();
+  void join();
+  void setError(const String* msg);
+  /** Colorizes one file. @return size of the input file */
+  unsigned __int64 colorize(ParserFactory* pf, RegionMapper* mapper, const BatchFile &file);
+  void writeHtml(std::wstring &out, const String* line, LineRegion* lineRegions);
+  void writeAnsi(std::wstring &out, const String* line, LineRegion* lineRegions, const StyledRegion* def);
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "CatalogLocations.h"
+#include <memory>
+#include <xml/XmlInputSource.h>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+
+CatalogLocations::CatalogLocations(const std::wstring &base_folder, std::vector<std::wstring>* locations_) :
+  baseFolder(base_folder), locations(locations_), depth(0), inHrcSets(false)
+{
+}
+
+void CatalogLocations::read(const String* catalogPath, std::vector<std::wstring> &locations)
+{
+  if (catalogPath == nullptr || !catalogPath->length()) {
+    return;
+  }
+  std::wstring path(catalogPath->getWChars());
+  size_t slash = path.find_last_of(L"\\/");
+  CatalogLocations handler(slash == std::wstring::npos ? std::wstring() : path.substr(0, slash + 1), &locations);
+
+  try {
+    std::unique_ptr<xercesc::SAX2XMLReader> reader(xercesc::XMLReaderFactory::createXMLReader());
+    reader->setFeature(xercesc::XMLUni::fgXercesLoadExternalDTD, false);
+    reader->setFeature(xercesc::XMLUni::fgXercesSkipDTDValidation, true);
+    reader->setContentHandler(&handler);
+    reader->setErrorHandler(&handler);
+    std::unique_ptr<XmlInputSource> config(XmlInputSource::newInstance(path.c_str(), static_cast<XMLCh*>(nullptr)));
+    reader->parse(*config->getInputSource());
+  } catch (...) {
+    // the catalog itself is checked by ParserFactory
+  }
+}
+
+void CatalogLocations::startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname,
+                                    const xercesc::Attributes &attrs)
+{
+  depth++;
+  if (depth == 2) {
+    inHrcSets = xercesc::XMLString::equals(qname, L"hrc-sets");
+    return;
+  }
+  if (depth != 3 || !inHrcSets || !xercesc::XMLString::equals(qname, L"location")) {
+    return;
+  }
+
+  const XMLCh* link = attrs.getValue(L"link");
+  if (link == nullptr || *link == '\0') {
+    return;
+  }
+  std::wstring location(link);
+  if (location.compare(0, 4, L"jar:") == 0) {
+    size_t archive_end = location.find(L'!');
+    location = location.substr(4, archive_end == std::wstring::npos ? std::wstring::npos : archive_end - 4);
+  }
+  for (auto c = location.begin(); c != location.end(); ++c) {
+    if (*c == L'/') {
+      *c = L'\\';
+    }
+  }
+  bool absolute = (location.size() > 1 && location[1] == L':') || (!location.empty() && location[0] == L'\\');
+  locations->push_back(absolute ? location : baseFolder + location);
+}
+
+void CatalogLocations::endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname)
+{
+  if (depth == 2) {
+    inHrcSets = false;
+  }
+  depth--;
+}
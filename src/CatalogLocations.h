@@ -0,0 +1,36 @@
+#ifndef _CATALOGLOCATIONS_H_
+#define _CATALOGLOCATIONS_H_
+
+#include <string>
+#include <vector>
+#include <colorer/unicode/String.h>
+#include <xercesc/sax2/DefaultHandler.hpp>
+
+/** Reads the hrc locations listed in the hrc-sets block of catalog.xml.
+    Only the paths are read, the schemes are loaded by ParserFactory.
+    @ingroup far_plugin
+*/
+class CatalogLocations : public xercesc::DefaultHandler
+{
+public:
+  /** Appends full paths of the locations to the list.
+      Relative links are resolved from the folder of the catalog,
+      for jar links the path of the archive is taken.
+      A broken catalog gives the locations read before the error.
+  */
+  static void read(const String* catalogPath, std::vector<std::wstring> &locations);
+
+  void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname,
+                    const xercesc::Attributes &attrs);
+  void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname);
+
+private:
+  CatalogLocations(const std::wstring &base_folder, std::vector<std::wstring>* locations_);
+
+  std::wstring baseFolder;
+  std::vector<std::wstring>* locations;
+  int depth;
+  bool inHrcSets;
+};
+
+#endif
@@ -2,92 +2,64 @@
 #include "FarEditor.h"
 #include "ChooseTypeMenu.h"
 
-ChooseTypeMenu::ChooseTypeMenu(const wchar_t* AutoDetect, const wchar_t* Favorites)
+ChooseTypeMenu::ChooseTypeMenu(const wchar_t* AutoDetect, const wchar_t* Favorites, TypeParams* tp) :
+  typeParams(tp)
 {
-  ItemCount = 0;
-  Item = nullptr;
   ItemSelected = 0;
+  Item.reserve(512);
 
   StringBuffer s;
   s.append(DString("&A ")).append(DString(AutoDetect));
-  AddItem(s.getWChars(), 0, nullptr, 0);
-  AddItem(Favorites, MIF_SEPARATOR, nullptr, 1);
+  AddItem(Labels.copy(s.getWChars()), 0, nullptr, 0);
+  AddItem(Labels.copy(Favorites), MIF_SEPARATOR, nullptr, 1);
 }
 
 ChooseTypeMenu::~ChooseTypeMenu()
 {
-  for (size_t idx = 0; idx < ItemCount; idx++) {
-    if (Item[idx].Text) {
-      free((void*) Item[idx].Text);
-    }
-  }
-  free(Item);
 }
 
 void ChooseTypeMenu::DeleteItem(size_t index)
 {
-  if (Item[index].Text) {
-    free((void*) Item[index].Text);
-  }
-  memmove(Item + index, Item + index + 1, sizeof(FarMenuItem) * (ItemCount - (index + 1)));
-  ItemCount--;
+  Item.erase(Item.begin() + index);
   if (ItemSelected >= index) {
     ItemSelected--;
   }
 }
 
-FarMenuItem* ChooseTypeMenu::getItems() const
+FarMenuItem* ChooseTypeMenu::getItems()
 {
-  return Item;
+  return Item.data();
 }
 
 size_t ChooseTypeMenu::AddItem(const wchar_t* Text, const MENUITEMFLAGS Flags, const FileType* UserData, size_t PosAdd)
 {
-  if (PosAdd > ItemCount) {
-    PosAdd = ItemCount;
-  }
-
-  if (!(ItemCount & 255)) {
-    FarMenuItem* NewPtr = static_cast<FarMenuItem*>(realloc(Item, sizeof(FarMenuItem) * (ItemCount + 256 + 1)));
-    if (!NewPtr) {
-      throw Exception(DString("ChooseTypeMenu: not enough available memory."));
-    }
-
-    Item = NewPtr;
+  if (PosAdd > Item.size()) {
+    PosAdd = Item.size();
   }
 
-  if (PosAdd < ItemCount) {
-    memmove(Item + PosAdd + 1, Item + PosAdd, sizeof(FarMenuItem) * (ItemCount - PosAdd));
-  }
-
-  ItemCount++;
-
-  Item[PosAdd].Flags = Flags;
-  Item[PosAdd].Text = _wcsdup(Text);
-  Item[PosAdd].UserData = (DWORD_PTR) UserData;
-  ZeroMemory(Item[PosAdd].Reserved, sizeof(Item[PosAdd].Reserved));
-  Item[PosAdd].AccelKey.ControlKeyState = 0;
-  Item[PosAdd].AccelKey.VirtualKeyCode = 0;
+  FarMenuItem NewItem;
+  ZeroMemory(&NewItem, sizeof(NewItem));
+  NewItem.Flags = Flags;
+  NewItem.Text = Text;
+  NewItem.UserData = (DWORD_PTR) UserData;
+  Item.insert(Item.begin() + PosAdd, NewItem);
 
   return PosAdd;
 }
 
 size_t ChooseTypeMenu::AddGroup(const wchar_t* Text)
 {
-  return AddItem(Text, MIF_SEPARATOR, nullptr);
+  return AddItem(Labels.copy(Text), MIF_SEPARATOR, nullptr);
 }
 
 size_t ChooseTypeMenu::AddItem(const FileType* fType, size_t PosAdd)
 {
-  StringBuffer* s = GenerateName(fType);
-  size_t k = AddItem(s->getWChars(), 0, fType, PosAdd);
-  delete s;
-  return k;
+  return AddItem(GenerateName(fType), 0, fType, PosAdd);
 }
 
 void ChooseTypeMenu::SetSelected(size_t index)
 {
-  if (index < ItemCount) {
+  if (index < Item.size()) {
     Item[ItemSelected].Flags &= ~MIF_SELECTED;
     Item[index].Flags |= MIF_SELECTED;
     ItemSelected = index;
@@ -97,15 +69,15 @@ void ChooseTypeMenu::SetSelected(size_t index)
 size_t ChooseTypeMenu::GetNext(size_t index) const
 {
   size_t p;
-  for (p = index + 1; p < ItemCount; p++) {
+  for (p = index + 1; p < Item.size(); p++) {
     if (!(Item[p].Flags & MIF_SEPARATOR)) {
       break;
     }
   }
-  if (p < ItemCount) {
+  if (p < Item.size()) {
     return p;
   } else {
-    for (p = favorite_idx; p < ItemCount && !(Item[p].Flags & MIF_SEPARATOR); p++);
+    for (p = favorite_idx; p < Item.size() && !(Item[p].Flags & MIF_SEPARATOR); p++);
     return p + 1;
   }
 }
@@ -115,6 +87,16 @@ FileType* ChooseTypeMenu::GetFileType(size_t index) const
   return (FileType*)Item[index].UserData;
 }
 
+size_t ChooseTypeMenu::FindFileType(const FileType* fType) const
+{
+  for (size_t i = favorite_idx; i < Item.size(); i++) {
+    if (Item[i].UserData == (DWORD_PTR) fType && !(Item[i].Flags & MIF_SEPARATOR)) {
+      return i;
+    }
+  }
+  return 0;
+}
+
 void ChooseTypeMenu::MoveToFavorites(size_t index)
 {
   FileTypeImpl* f = (FileTypeImpl*)Item[index].UserData;
@@ -126,22 +108,23 @@ void ChooseTypeMenu::MoveToFavorites(size_t index)
     f->addParam(&DFavorite);
   }
   f->setParamValue(DFavorite, &DTrue);
+  typeParams->invalidate(f);
 }
 
 size_t ChooseTypeMenu::AddFavorite(const FileType* fType)
 {
   size_t i;
-  for (i = favorite_idx; i < ItemCount && !(Item[i].Flags & MIF_SEPARATOR); i++);
-  size_t p = AddItem(fType, i = ItemCount ? i : i + 1);
+  for (i = favorite_idx; i < Item.size() && !(Item[i].Flags & MIF_SEPARATOR); i++);
+  size_t p = AddItem(fType, i = Item.size() ? i : i + 1);
   if (ItemSelected >= p) {
     ItemSelected++;
   }
   return p;
 }
 
-void ChooseTypeMenu::HideEmptyGroup() const
+void ChooseTypeMenu::HideEmptyGroup()
 {
-  for (size_t i = favorite_idx; i < ItemCount - 1; i++) {
+  for (size_t i = favorite_idx; i < Item.size() - 1; i++) {
     if ((Item[i].Flags & MIF_SEPARATOR) && (Item[i + 1].Flags & MIF_SEPARATOR)) {
       Item[i].Flags |= MIF_HIDDEN;
     }
@@ -159,13 +142,17 @@ void ChooseTypeMenu::DelFromFavorites(size_t index)
     SetSelected(index);
   }
   f->setParamValue(DFavorite, &DFalse);
+  typeParams->invalidate(f);
 }
 
 size_t ChooseTypeMenu::AddItemInGroup(FileType* fType)
 {
   size_t i;
   const String* group = fType->getGroup();
-  for (i = favorite_idx; i < ItemCount && !((Item[i].Flags & MIF_SEPARATOR) && (group->compareTo(DString(Item[i].Text)) == 0)); i++);
+  for (i = favorite_idx; i < Item.size() && !((Item[i].Flags & MIF_SEPARATOR) && (group->compareTo(DString(Item[i].Text)) == 0)); i++);
+  if (i == Item.size()) {
+    i = AddGroup(group->getWChars());
+  }
   if (Item[i].Flags & MIF_HIDDEN) {
     Item[i].Flags &= ~MIF_HIDDEN;
   }
@@ -179,8 +166,8 @@ size_t ChooseTypeMenu::AddItemInGroup(FileType* fType)
 bool ChooseTypeMenu::IsFavorite(size_t index) const
 {
   size_t i;
-  for (i = favorite_idx; i < ItemCount && !(Item[i].Flags & MIF_SEPARATOR); i++);
-  i = ItemCount ? i : i + 1;
+  for (i = favorite_idx; i < Item.size() && !(Item[i].Flags & MIF_SEPARATOR); i++);
+  i = Item.size() ? i : i + 1;
   if (i > index) {
     return true;
   }
@@ -189,26 +176,54 @@ bool ChooseTypeMenu::IsFavorite(size_t index) const
 
 void ChooseTypeMenu::RefreshItemCaption(size_t index)
 {
-  if (Item[index].Text) {
-    free((void*) Item[index].Text);
+  FileType* fType = GetFileType(index);
+  const String* v = typeParams->getValue(fType, TP_HOTKEY);
+  const String* descr = fType->getDescription();
+  size_t hlen = v != nullptr ? v->length() : 0;
+  size_t dlen = descr ? descr->length() : 0;
+
+  // the label has room for a hotkey of hotkey_room chars or of the current one,
+  // the menu lives for the whole session, so a label is replaced only if the hotkey doesn't fit
+  wchar_t* label = const_cast<wchar_t*>(Item[index].Text);
+  size_t room = label[0] == '&' ? wcslen(label) - dlen - 2 : 0;
+  if (hlen <= room || hlen <= hotkey_room) {
+    WriteName(label, v, descr);
+  } else {
+    Item[index].Text = GenerateName(fType);
   }
-
-  StringBuffer* s = GenerateName(GetFileType(index));
-  Item[index].Text = _wcsdup(s->getWChars());
-  delete s;
 }
 
-StringBuffer* ChooseTypeMenu::GenerateName(const FileType* fType)
+const wchar_t* ChooseTypeMenu::GenerateName(const FileType* fType)
 {
   const String* v;
-  v = ((FileTypeImpl*)fType)->getParamValue(DHotkey);
-  StringBuffer* s = new StringBuffer;
-  if (v != nullptr && v->length()) {
-    s->append(DString("&")).append(v);
-  } else {
-    s->append(DString(" "));
-  }
-  s->append(DString(" ")).append(((FileType*)fType)->getDescription());
+  v = typeParams->getValue((FileType*)fType, TP_HOTKEY);
+  const String* descr = ((FileType*)fType)->getDescription();
+  size_t hlen = v != nullptr ? v->length() : 0;
+  size_t dlen = descr ? descr->length() : 0;
 
+  wchar_t* s = Labels.alloc((hlen > hotkey_room ? hlen : hotkey_room) + dlen + 3);
+  WriteName(s, v, descr);
   return s;
+}
+
+void ChooseTypeMenu::WriteName(wchar_t* s, const String* v, const String* descr)
+{
+  size_t hlen = v != nullptr ? v->length() : 0;
+  size_t dlen = descr ? descr->length() : 0;
+
+  // "&hotkey description" or "  description"
+  size_t pos = 0;
+  if (hlen) {
+    s[pos++] = '&';
+    wmemcpy(s + pos, v->getWChars(), hlen);
+    pos += hlen;
+  } else {
+    s[pos++] = ' ';
+  }
+  s[pos++] = ' ';
+  if (dlen) {
+    wmemcpy(s + pos, descr->getWChars(), dlen);
+    pos += dlen;
+  }
+  s[pos] = 0;
 }
\ No newline at end of file
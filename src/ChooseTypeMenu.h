@@ -2,16 +2,18 @@
 #define _CHOOSE_TYPE_MENU_H_
 
 #include "pcolorer.h"
+#include "MenuArena.h"
+#include "TypeParams.h"
 
 class ChooseTypeMenu
 {
 public:
-  ChooseTypeMenu(const wchar_t* AutoDetect, const wchar_t* Favorites);
+  ChooseTypeMenu(const wchar_t* AutoDetect, const wchar_t* Favorites, TypeParams* tp);
   ~ChooseTypeMenu();
-  FarMenuItem* getItems() const;
+  FarMenuItem* getItems();
   size_t getItemsCount() const
   {
-    return ItemCount;
+    return Item.size();
   }
 
   size_t AddItem(const FileType* fType, size_t PosAdd = 0x7FFFFFFF);
@@ -20,25 +22,34 @@ public:
   void SetSelected(size_t index);
   size_t GetNext(size_t index) const;
   FileType* GetFileType(size_t index) const;
+  /** Index of the item of the type, 0 (auto detect) if there is no such item */
+  size_t FindFileType(const FileType* fType) const;
   void MoveToFavorites(size_t index);
   size_t AddFavorite(const FileType* fType);
   void DeleteItem(size_t index);
 
-  void HideEmptyGroup() const;
+  void HideEmptyGroup();
   void DelFromFavorites(size_t index);
   bool IsFavorite(size_t index) const;
   void RefreshItemCaption(size_t index);
-  StringBuffer* GenerateName(const FileType* fType);
+  const wchar_t* GenerateName(const FileType* fType);
 
 private:
-  size_t ItemCount;
-  FarMenuItem* Item;
+  std::vector<FarMenuItem> Item;
+  /** storage of item labels */
+  MenuArena Labels;
+  TypeParams* typeParams;
 
   size_t ItemSelected; // Index of selected item
 
   size_t AddItem(const wchar_t* Text, const MENUITEMFLAGS Flags, const FileType* UserData = nullptr, size_t PosAdd = 0x7FFFFFFF);
 
+  /** Writes the label of the type to the buffer */
+  static void WriteName(wchar_t* s, const String* v, const String* descr);
+
   static const size_t favorite_idx = 2;
+  /** hotkey length the labels have room for */
+  static const size_t hotkey_room = 4;
 };
 
 
@@ -1,26 +1,29 @@
+#include <algorithm>
 #include <common/Logging.h>
 #include "FarEditor.h"
+#include "FuzzyMatcher.h"
+#include "MenuArena.h"
+#include "tools.h"
 
-FarEditor::FarEditor(PluginStartupInfo* info_, ParserFactory* pf) :
-  info(info_), parserFactory(pf), maxLineLength(0), fullBackground(true), drawCross(0), CrossStyle(0), showVerticalCross(false),
+FarEditor::FarEditor(PluginStartupInfo* info_, ParserFactory* pf, TypeParams* tp, std::shared_ptr<ParseDocument> doc) :
+  info(info_), parserFactory(pf), typeParams(tp), maxLineLength(0), fullBackground(true), drawCross(0), CrossStyle(0), showVerticalCross(false),
     showHorizontalCross(false), crossZOrder(0), drawPairs(true), drawSyntax(true), oldOutline(false), TrueMod(true),
     WindowSizeX(0), WindowSizeY(0), inRedraw(false), idleCount(0), prevLinePosition(0), blockTopPosition(-1),
-    ret_str(nullptr), ret_strNumber(SIZE_MAX), newfore(-1), newback(-1), rdBackground(nullptr), cursorRegion(nullptr),
-    visibleLevel(100), editor_id(-1)
+    ret_str(nullptr), ret_strNumber(SIZE_MAX), newfore(-1), newback(-1), rdBackground(nullptr),
+    regionMapper(nullptr), visibleLevel(100), editor_id(-1)
 {
-  DString def_out = DString("def:Outlined");
-  DString def_err = DString("def:Error");
-  baseEditor = new BaseEditor(parserFactory, this);
-  const Region* def_Outlined = pf->getHRCParser()->getRegion(&def_out);
-  const Region* def_Error = pf->getHRCParser()->getRegion(&def_err);
-  structOutliner = new Outliner(baseEditor, def_Outlined);
-  errorOutliner = new Outliner(baseEditor, def_Error);
-
   EditorInfo ei = {0};
   ei.StructSize = sizeof(EditorInfo);
   info->EditorControl(CurrentEditor, ECTL_GETINFO, 0, &ei);
   editor_id = ei.EditorID;
 
+  if (doc) {
+    attachDocument(doc);
+    reloadTypeSettings();
+  } else {
+    createBaseEditor();
+  }
+
   // subscribe for event change text
   EditorSubscribeChangeEvent esce = { sizeof(EditorSubscribeChangeEvent), MainGuid };
   info->EditorControl(editor_id, ECTL_SUBSCRIBECHANGEEVENT, 0, &esce);
@@ -35,13 +38,92 @@ FarEditor::~FarEditor()
   EditorSubscribeChangeEvent esce = { sizeof(EditorSubscribeChangeEvent), MainGuid };
   info->EditorControl(editor_id, ECTL_UNSUBSCRIBECHANGEEVENT, 0, &esce);
 
-  delete cursorRegion;
-  delete structOutliner;
-  delete errorOutliner;
-  delete baseEditor;
+  document->detach(this);
   delete ret_str;
 }
 
+void FarEditor::createBaseEditor()
+{
+  attachDocument(std::make_shared<ParseDocument>(parserFactory));
+}
+
+void FarEditor::attachDocument(std::shared_ptr<ParseDocument> doc)
+{
+  if (document) {
+    document->detach(this);
+  }
+  document = doc;
+  document->attach(this);
+  baseEditor = document->baseEditor;
+  structOutliner = document->structOutliner;
+  errorOutliner = document->errorOutliner;
+  pairIndex = document->pairIndex;
+  cursorIndex.clear();
+  regionChain.clear();
+}
+
+void FarEditor::unshareDocument()
+{
+  if (document->viewCount() < 2) {
+    return;
+  }
+  FileType* ftype = baseEditor->getFileType();
+  createBaseEditor();
+  setFileType(ftype);
+  if (regionMapper != nullptr) {
+    setRegionMapper(regionMapper);
+  }
+}
+
+void FarEditor::changeParserFactory(ParserFactory* pf, RegionMapper* rs, String* fname)
+{
+  // the file type is kept by name, it could be chosen by user
+  std::unique_ptr<SString> typeName;
+  FileType* oldType = baseEditor->getFileType();
+  if (oldType != nullptr) {
+    typeName.reset(new SString(*oldType->getName()));
+  }
+
+  blockTopPosition = -1;
+
+  parserFactory = pf;
+  renewDocument();
+
+  FileType* ftype = typeName ? parserFactory->getHRCParser()->getFileType(typeName.get()) : nullptr;
+  if (ftype != nullptr) {
+    setFileType(ftype);
+  } else {
+    chooseFileType(fname);
+  }
+  // text is parsed again on the next redraw, only the visible part
+  setRegionMapper(rs);
+}
+
+void FarEditor::dropParseState()
+{
+  FileType* ftype = baseEditor->getFileType();
+  blockTopPosition = -1;
+  renewDocument();
+  if (ftype != nullptr) {
+    setFileType(ftype);
+  }
+  if (regionMapper != nullptr) {
+    setRegionMapper(regionMapper);
+  }
+}
+
+void FarEditor::renewDocument()
+{
+  // the new document has the same text, so it is reused on the same conditions
+  ParseDocument::FileState fileState = document->fileState;
+  bool textChanged = document->getGeneration() != 0;
+  createBaseEditor();
+  document->fileState = fileState;
+  if (textChanged) {
+    document->changed();
+  }
+}
+
 void FarEditor::endJob(int lno)
 {
   delete ret_str;
@@ -80,12 +162,68 @@ void FarEditor::chooseFileType(String* fname)
   setFileType(ftype);
 }
 
+unsigned int FarEditor::getTextStartHash() const
+{
+  // the same lines as BaseEditor::chooseFileType passes to the patterns
+  int chooseStr = 4;
+  int chooseLen = 800;
+  FileType* def = typeParams->getDefaultType();
+  if (def != nullptr) {
+    chooseStr = typeParams->getValueInt(def, TP_FIRSTLINES);
+    chooseLen = typeParams->getValueInt(def, TP_FIRSTLINEBYTES);
+  }
+
+  EditorInfo ei;
+  ei.StructSize = sizeof(EditorInfo);
+  info->EditorControl(editor_id, ECTL_GETINFO, 0, &ei);
+
+  // FNV-1a
+  unsigned int hash = 2166136261u;
+  int total = 0;
+  for (intptr_t lno = 0; lno < ei.TotalLines && lno < chooseStr && total < chooseLen; lno++) {
+    EditorGetString egs = {0};
+    egs.StructSize = sizeof(EditorGetString);
+    egs.StringNumber = lno;
+    if (!info->EditorControl(editor_id, ECTL_GETSTRING, 0, &egs)) {
+      break;
+    }
+    for (intptr_t i = 0; i < egs.StringLength && total < chooseLen; i++, total++) {
+      hash = (hash ^ egs.StringText[i]) * 16777619u;
+    }
+    hash = (hash ^ L'\n') * 16777619u;
+  }
+  return hash;
+}
+
+void FarEditor::exportTokens(TokenStreamWriter &writer)
+{
+  EditorInfo ei;
+  ei.StructSize = sizeof(EditorInfo);
+  info->EditorControl(editor_id, ECTL_GETINFO, 0, &ei);
+  baseEditor->lineCountEvent((int)ei.TotalLines);
+
+  for (intptr_t lno = 0; lno < ei.TotalLines; lno++) {
+    // regions are taken first, the parser reads the lines itself
+    LineRegion* lr = baseEditor->getLineRegions((int)lno);
+    EditorGetString egs = {0};
+    egs.StructSize = sizeof(EditorGetString);
+    egs.StringNumber = lno;
+    if (!info->EditorControl(editor_id, ECTL_GETSTRING, 0, &egs)) {
+      break;
+    }
+    writer.addLine((int)egs.StringLength, lr);
+  }
+}
+
 void FarEditor::setFileType(FileType* ftype)
 {
+  // other editors of the file keep their type
+  unshareDocument();
   baseEditor->setFileType(ftype);
   // clear Outliner
   structOutliner->modifyEvent(0);
   errorOutliner->modifyEvent(0);
+  pairIndex->modifyEvent(0);
 
   reloadTypeSettings();
 }
@@ -93,39 +231,23 @@ void FarEditor::setFileType(FileType* ftype)
 void FarEditor::reloadTypeSettings()
 {
   FileType* ftype = baseEditor->getFileType();
-  HRCParser* hrcParser = parserFactory->getHRCParser();
-  FileType* def = hrcParser->getFileType(&DDefaultScheme);
 
-  if (def == nullptr) {
+  if (typeParams->getDefaultType() == nullptr) {
     throw Exception(DString("No 'default' file type found"));
   }
 
-  int backparse = def->getParamValueInt(DBackparse, 2000);
-  backparse = ftype->getParamValueInt(DBackparse, backparse);
-  baseEditor->setBackParse(backparse);
-
-  maxLineLength = def->getParamValueInt(DMaxLen, 0);
-  maxLineLength = ftype->getParamValueInt(DMaxLen, maxLineLength);
-
-  newfore = def->getParamValueInt(DDefFore, -1);
-  newfore = ftype->getParamValueInt(DDefFore, newfore);
-
-  newback = def->getParamValueInt(DDefBack, -1);
-  newback = ftype->getParamValueInt(DDefBack, newback);
+  baseEditor->setBackParse(typeParams->getValueInt(ftype, TP_BACKPARSE));
+  maxLineLength = typeParams->getValueInt(ftype, TP_MAXLINELENGTH);
+  newfore = typeParams->getValueInt(ftype, TP_DEFAULT_FORE);
+  newback = typeParams->getValueInt(ftype, TP_DEFAULT_BACK);
 
   const String* value;
-  value = ftype->getParamValue(DFullback);
-  if (!value) {
-    value = def->getParamValue(DFullback);
-  }
+  value = typeParams->getValue(ftype, TP_FULLBACK);
   if (value != nullptr && value->equals(&DNo)) {
     fullBackground = false;
   }
 
-  value = ftype->getParamValue(DCrossZorder);
-  if (!value) {
-    value = def->getParamValue(DCrossZorder);
-  }
+  value = typeParams->getValue(ftype, TP_CROSS_ZORDER);
   if (value != nullptr && value->equals(&DTop)) {
     crossZOrder = 1;
   }
@@ -162,14 +284,7 @@ void FarEditor::setDrawCross(int _drawCross, int _CrossStyle)
       }
       break;
     case 2:
-      FileType* ftype = baseEditor->getFileType();
-      HRCParser* hrcParser = parserFactory->getHRCParser();
-      FileType* def = hrcParser->getFileType(&DDefaultScheme);
-      const String* value;
-      value = ftype->getParamValue(DShowCross);
-      if (!value) {
-        value = def->getParamValue(DShowCross);
-      }
+      const String* value = typeParams->getValue(baseEditor->getFileType(), TP_SHOW_CROSS);
 
       if (value) {
         if (value->equals(&DNone)) {
@@ -218,6 +333,7 @@ void FarEditor::setTrueMod(bool _TrueMod)
 
 void FarEditor::setRegionMapper(RegionMapper* rs)
 {
+  regionMapper = rs;
   baseEditor->setRegionMapper(rs);
   rdBackground = StyledRegion::cast(baseEditor->rd_def_Text);
   horzCrossColor = convert(StyledRegion::cast(baseEditor->rd_def_HorzCross));
@@ -237,7 +353,7 @@ void FarEditor::matchPair()
   EditorSetPosition esp;
   esp.StructSize = sizeof(EditorSetPosition);
   EditorInfo ei = enterHandler();
-  PairMatch* pm = baseEditor->searchGlobalPair((int)ei.CurLine, (int)ei.CurPos);
+  PairMatch* pm = searchPair(ei, true);
 
   if ((pm == nullptr) || (pm->eline == -1)) {
     baseEditor->releasePairMatch(pm);
@@ -274,7 +390,7 @@ void FarEditor::selectPair()
   es.StructSize = sizeof(EditorSelect);
   int X1, X2, Y1, Y2;
   EditorInfo ei = enterHandler();
-  PairMatch* pm = baseEditor->searchGlobalPair((int)ei.CurLine, (int)ei.CurPos);
+  PairMatch* pm = searchPair(ei, true);
 
   if ((pm == nullptr) || (pm->eline == -1)) {
     baseEditor->releasePairMatch(pm);
@@ -310,7 +426,7 @@ void FarEditor::selectBlock()
   es.StructSize = sizeof(EditorSelect);
   int X1, X2, Y1, Y2;
   EditorInfo ei = enterHandler();
-  PairMatch* pm = baseEditor->searchGlobalPair((int)ei.CurLine, (int)ei.CurPos);
+  PairMatch* pm = searchPair(ei, true);
 
   if ((pm == nullptr) || (pm->eline == -1)) {
     baseEditor->releasePairMatch(pm);
@@ -349,6 +465,19 @@ void FarEditor::selectRegion()
   EditorInfo ei = enterHandler();
   egs.StringNumber = ei.CurLine;
   info->EditorControl(editor_id, ECTL_GETSTRING, 0, &egs);
+  const LineRegion* cursorRegion = getCursorRegion(ei, egs.StringLength);
+  if (cursorRegion != nullptr && ei.BlockType == BTYPE_STREAM && ei.BlockStartLine == ei.CurLine && egs.SelStart != -1) {
+    // repeated selection expands it to the enclosing region
+    intptr_t sel_end = egs.SelEnd == -1 ? egs.StringLength : egs.SelEnd;
+    cursorIndex.enclosing((int)ei.CurPos, regionChain);
+    for (auto it = regionChain.begin(); it != regionChain.end(); ++it) {
+      intptr_t end = (*it)->end == -1 ? egs.StringLength : (*it)->end;
+      if ((*it)->start <= egs.SelStart && end >= sel_end && end - (*it)->start > sel_end - egs.SelStart) {
+        cursorRegion = *it;
+        break;
+      }
+    }
+  }
   if (cursorRegion != nullptr) {
     intptr_t end = cursorRegion->end;
 
@@ -374,6 +503,7 @@ void FarEditor::getNameCurrentScheme()
   EditorInfo ei = enterHandler();
   egs.StringNumber = ei.CurLine;
   info->EditorControl(editor_id, ECTL_GETSTRING, 0, &egs);
+  const LineRegion* cursorRegion = getCursorRegion(ei, egs.StringLength);
   if (cursorRegion != nullptr) {
     StringBuffer region, scheme;
     region.append(DString(L"Region: "));
@@ -484,6 +614,71 @@ void FarEditor::locateFunction()
   info->Message(&MainGuid, &NothingFoundMesage, 0, nullptr, msg, 2, 1);
 }
 
+bool FarEditor::findRegion(const String* regionName, bool forward)
+{
+  RegionIndex* regionIndex = document->getRegionIndex();
+  if (!regionIndex->setRegion(regionName)) {
+    return false;
+  }
+
+  EditorInfo ei = enterHandler();
+  RegionIndex::Occurrence item;
+  RegionIndex::SearchResult res;
+  HANDLE scr = nullptr;
+  // the text is parsed in time slices, the progress is shown between them, Esc stops the search
+  while ((res = regionIndex->find(ei.CurLine, (int)ei.CurPos, forward, ei.TotalLines, 200, item)) == RegionIndex::SR_TIMEOUT) {
+    if (CheckForEsc()) {
+      break;
+    }
+    wchar_t progress[64];
+    _snwprintf(progress, 64, GetMsg(mRegionSearchProgress), (int)regionIndex->indexedLines(), (int)ei.TotalLines);
+    progress[63] = 0;
+    const wchar_t* marr[2] = { GetMsg(mName), progress };
+    if (scr == nullptr) {
+      scr = info->SaveScreen(0, 0, -1, -1);
+    }
+    info->Message(&MainGuid, &RegionSearchMessage, 0, nullptr, &marr[0], 2, 0);
+  }
+  if (scr != nullptr) {
+    info->RestoreScreen(scr);
+  }
+  if (res != RegionIndex::SR_FOUND) {
+    return false;
+  }
+
+  EditorSetPosition esp;
+  esp.StructSize = sizeof(EditorSetPosition);
+  esp.CurTabPos = esp.LeftPos = esp.Overtype = esp.TopScreenLine = -1;
+  esp.CurLine = item.lno;
+  esp.CurPos = item.start;
+  if (esp.CurLine < ei.TopScreenLine || esp.CurLine >= ei.TopScreenLine + ei.WindowSizeY) {
+    esp.TopScreenLine = esp.CurLine - ei.WindowSizeY / 2;
+
+    if (esp.TopScreenLine < 0) {
+      esp.TopScreenLine = 0;
+    }
+  }
+  info->EditorControl(editor_id, ECTL_SETPOSITION, 0, &esp);
+
+  EditorGetString egs = {0};
+  egs.StructSize = sizeof(EditorGetString);
+  egs.StringNumber = item.lno;
+  info->EditorControl(editor_id, ECTL_GETSTRING, 0, &egs);
+  intptr_t end = (item.end == -1 || item.end > egs.StringLength) ? egs.StringLength : item.end;
+  if (end - item.start > 0) {
+    EditorSelect es;
+    es.StructSize = sizeof(EditorSelect);
+    es.BlockType = BTYPE_STREAM;
+    es.BlockStartLine = item.lno;
+    es.BlockStartPos = item.start;
+    es.BlockHeight = 1;
+    es.BlockWidth = end - item.start;
+    info->EditorControl(editor_id, ECTL_SELECT, 0, &es);
+  }
+  info->EditorControl(editor_id, ECTL_REDRAW, 0, nullptr);
+  return true;
+}
+
 void FarEditor::updateHighlighting()
 {
   EditorInfo ei = enterHandler();
@@ -571,6 +766,9 @@ int FarEditor::editorEvent(intptr_t event, void* param)
       ml = blockTopPosition;
     }
 
+    // the text differs from the other editors of the file now
+    unshareDocument();
+    document->changed();
     baseEditor->modifyEvent(ml);
     return 0;
   }
@@ -598,9 +796,6 @@ int FarEditor::editorEvent(intptr_t event, void* param)
     blockTopPosition = (int)ei.BlockStartLine;
   }
 
-  delete cursorRegion;
-  cursorRegion = nullptr;
-
   // Position the cursor on the screen
   EditorConvertPos ecp, ecp_cl;
   ecp.StructSize = sizeof(EditorConvertPos);
@@ -653,10 +848,6 @@ int FarEditor::editorEvent(intptr_t event, void* param)
         if (lend == -1) {
           lend = fullBackground ? (int)(ei.LeftPos + ei.WindowSizeX) : llen;
         }
-        if (lno == ei.CurLine && (l1->start <= ei.CurPos) && (ei.CurPos <= lend)) {
-          delete cursorRegion;
-          cursorRegion = new LineRegion(*l1);
-        }
 
         FarColor col = convert(l1->styled());
         // remove the front in color whitespaces to display correctly in the far hidden characters (tab, space)
@@ -733,7 +924,7 @@ int FarEditor::editorEvent(intptr_t event, void* param)
 
   // pair brackets
   if (drawPairs) {
-    PairMatch* pm = baseEditor->searchLocalPair((int)ei.CurLine, (int)ei.CurPos);
+    PairMatch* pm = searchPair(ei, false);
     if (pm != nullptr) {
       // start bracket
       FarColor col = convert(pm->start->styled());
@@ -787,7 +978,6 @@ int FarEditor::editorEvent(intptr_t event, void* param)
 
 void FarEditor::showOutliner(Outliner* outliner)
 {
-  FarMenuItem* menu;
   EditorSetPosition esp;
   esp.StructSize = sizeof(EditorSetPosition);
   bool moved = false;
@@ -807,7 +997,6 @@ void FarEditor::showOutliner(Outliner* outliner)
   };
   int keys_size = sizeof(breakKeys) / sizeof(FarKey);
 
-  wchar_t prefix[FILTER_SIZE + 1];
   wchar_t autofilter[FILTER_SIZE + 1];
   wchar_t filter[FILTER_SIZE + 1];
   int  flen = 0;
@@ -820,78 +1009,105 @@ void FarEditor::showOutliner(Outliner* outliner)
     stopMenu = true;
   }
 
-  menu = new FarMenuItem[items_num];
+  // items and labels are reused by each rebuild of the menu
+  std::vector<FarMenuItem> menu(items_num);
+  MenuArena labels;
   EditorInfo ei_curr = enterHandler();
 
+  FuzzyMatcher matcher;
+  for (size_t idx = 0; idx < items_num; idx++) {
+    matcher.add(outliner->getItem(idx)->token.get());
+  }
+  std::vector<int> scores;
+  std::vector<int> itemLevels(items_num);
+  std::vector<size_t> visible;
+
   while (!stopMenu) {
-    int i;
-    memset(menu, 0, sizeof(FarMenuItem)*items_num);
+    size_t i;
+    memset(menu.data(), 0, sizeof(FarMenuItem)*items_num);
+    labels.reset();
     // items in FAR's menu;
     int menu_size = 0;
     int selectedItem = 0;
     std::vector<int> treeStack;
 
     EditorInfo ei = enterHandler();
+    matcher.match(filter, scores);
+    visible.clear();
     for (i = 0; i < items_num; i++) {
-      OutlineItem* item = outliner->getItem(i);
-
-      if (item->token->indexOfIgnoreCase(DString(filter)) != -1) {
-        int treeLevel = Outliner::manageTree(treeStack, item->level);
+      if (scores[i] < 0) {
+        continue;
+      }
 
-        if (maxLevel < treeLevel) {
-          maxLevel = treeLevel;
-        }
+      int treeLevel = Outliner::manageTree(treeStack, outliner->getItem(i)->level);
 
-        if (treeLevel > visibleLevel) {
-          continue;
-        }
+      if (maxLevel < treeLevel) {
+        maxLevel = treeLevel;
+      }
 
-        wchar_t* menuItem = new wchar_t[255];
+      if (treeLevel > visibleLevel) {
+        continue;
+      }
 
-        if (!oldOutline) {
-          int si = _snwprintf(menuItem, 255, L"%4d ", item->lno + 1);
+      itemLevels[i] = treeLevel;
+      visible.push_back(i);
+    }
 
-          for (int lIdx = 0; lIdx < treeLevel; lIdx++) {
-            menuItem[si++] = ' ';
-            menuItem[si++] = ' ';
-          }
+    if (flen > 0) {
+      // the best matches go first
+      std::stable_sort(visible.begin(), visible.end(), [&scores](size_t a, size_t b) {
+        return scores[a] > scores[b];
+      });
+    }
 
-          const String* region = item->region->getName();
+    for (auto idx = visible.begin(); idx != visible.end(); ++idx) {
+      OutlineItem* item = outliner->getItem(*idx);
+      int treeLevel = itemLevels[*idx];
+      wchar_t menuItem[255];
 
-          wchar_t cls = Character::toLowerCase((*region)[region->indexOf(':') + 1]);
+      if (!oldOutline) {
+        int si = _snwprintf(menuItem, 255, L"%4d ", item->lno + 1);
 
-          si += _snwprintf(menuItem + si, 255 - si, L"%c ", cls);
+        for (int lIdx = 0; lIdx < treeLevel; lIdx++) {
+          menuItem[si++] = ' ';
+          menuItem[si++] = ' ';
+        }
 
-          int labelLength = item->token->length();
+        const String* region = item->region->getName();
 
-          if (labelLength + si > 110) {
-            labelLength = 110;
-          }
+        wchar_t cls = Character::toLowerCase((*region)[region->indexOf(':') + 1]);
 
-          wcsncpy(menuItem + si, item->token->getWChars(), labelLength);
-          menuItem[si + labelLength] = 0;
-        } else {
-          String* line = getLine(item->lno);
-          int labelLength = line->length();
+        si += _snwprintf(menuItem + si, 255 - si, L"%c ", cls);
 
-          if (labelLength > 110) {
-            labelLength = 110;
-          }
+        int labelLength = item->token->length();
 
-          wcsncpy(menuItem, line->getWChars(), labelLength);
-          menuItem[labelLength] = 0;
+        if (labelLength + si > 110) {
+          labelLength = 110;
         }
 
-        // set position on nearest top function
-        menu[menu_size].Text = menuItem;
-        menu[menu_size].UserData = reinterpret_cast<intptr_t>(item);
+        wcsncpy(menuItem + si, item->token->getWChars(), labelLength);
+        menuItem[si + labelLength] = 0;
+      } else {
+        String* line = getLine(item->lno);
+        int labelLength = line->length();
 
-        if (ei.CurLine >= (int)item->lno) {
-          selectedItem = menu_size;
+        if (labelLength > 110) {
+          labelLength = 110;
         }
 
-        menu_size++;
+        wcsncpy(menuItem, line->getWChars(), labelLength);
+        menuItem[labelLength] = 0;
+      }
+
+      menu[menu_size].Text = labels.copy(menuItem);
+      menu[menu_size].UserData = reinterpret_cast<intptr_t>(item);
+
+      // set position on nearest top function, or on the best match
+      if (flen == 0 && ei.CurLine >= (int)item->lno) {
+        selectedItem = menu_size;
       }
+
+      menu_size++;
     }
 
     if (selectedItem > 0) {
@@ -905,32 +1121,35 @@ void FarEditor::showOutliner(Outliner* outliner)
     }
 
     int aflen = flen;
-    // Find same function prefix
-    bool same = true;
-    int plen = 0;
     wcscpy(autofilter, filter);
 
-    while (code != 0 && menu_size > 1 && same && plen < FILTER_SIZE) {
-      plen = aflen + 1;
-      int auto_ptr  = DString(menu[0].Text).indexOfIgnoreCase(DString(autofilter));
-
-      if (int(wcslen(menu[0].Text) - auto_ptr) < plen) {
-        break;
-      }
-
-      wcsncpy(prefix, menu[0].Text + auto_ptr, plen);
-      prefix[plen] = 0;
+    // Find the same continuation of the filter in all items
+    if (code != 0 && menu_size > 1 && flen > 0) {
+      const wchar_t* first = nullptr;
+      size_t common = FILTER_SIZE - flen;
 
-      for (int j = 1 ; j < menu_size ; j++) {
-        if (DString(menu[j].Text).indexOfIgnoreCase(DString(prefix)) == -1) {
-          same = false;
+      for (auto idx = visible.begin(); idx != visible.end() && common > 0; ++idx) {
+        int pos = matcher.getSubstring(*idx);
+        if (pos == -1) {
+          common = 0;
           break;
         }
+
+        const wchar_t* rest = matcher.getText(*idx) + pos + flen;
+        if (first == nullptr) {
+          first = rest;
+        }
+        size_t k = 0;
+        while (k < common && rest[k] && rest[k] == first[k]) {
+          k++;
+        }
+        common = k;
       }
 
-      if (same) {
-        aflen++;
-        wcscpy(autofilter, prefix);
+      if (common > 0) {
+        wcsncpy(autofilter + flen, first, common);
+        aflen = flen + (int)common;
+        autofilter[aflen] = 0;
       }
     }
 
@@ -949,7 +1168,7 @@ void FarEditor::showOutliner(Outliner* outliner)
     _snwprintf(top, 128, topline, captionfilter);
 
     intptr_t sel = info->Menu(&MainGuid, &OutlinerMenu, -1, -1, 0, FMENU_SHOWAMPERSAND | FMENU_WRAPMODE,
-                     top, GetMsg(mChoose), L"add", breakKeys, &code, menu, menu_size);
+                     top, GetMsg(mChoose), L"add", breakKeys, &code, menu.data(), menu_size);
 
     // handle mouse selection
     if (sel != -1 && code == -1) {
@@ -1138,12 +1357,6 @@ void FarEditor::showOutliner(Outliner* outliner)
     }
   }
 
-  for (int i = 0; i < items_num; i++) {
-    delete[] menu[i].Text;
-  }
-
-  delete[] menu;
-
   if (!moved) {
     // restoring position
     esp.CurLine = ei_curr.CurLine;
@@ -1161,6 +1374,76 @@ void FarEditor::showOutliner(Outliner* outliner)
   }
 }
 
+PairMatch* FarEditor::searchPair(const EditorInfo &ei, bool global)
+{
+  size_t lno = ei.CurLine;
+  int pos = (int)ei.CurPos;
+  if (lno >= pairIndex->indexedLines()) {
+    // text before the cursor was not parsed continuously
+    if (global) {
+      return baseEditor->searchGlobalPair((int)lno, pos);
+    }
+    return baseEditor->searchLocalPair((int)lno, pos);
+  }
+
+  const PairToken* token = pairIndex->getToken(lno, pos);
+  if (token == nullptr) {
+    return nullptr;
+  }
+  const PairToken* partner = pairIndex->getPartner(token);
+  // pair end can be in the not parsed part of the text, it is parsed in growing steps
+  size_t step = cPairParseStep;
+  while (partner == nullptr && token->open && global && pairIndex->indexedLines() < (size_t)ei.TotalLines) {
+    size_t indexed = pairIndex->indexedLines();
+    baseEditor->validate((int)std::min<size_t>(indexed + step, ei.TotalLines - 1), false);
+    if (pairIndex->indexedLines() <= indexed) {
+      break;
+    }
+    step *= 2;
+    // parsing moves tokens
+    token = pairIndex->getToken(lno, pos);
+    if (token == nullptr) {
+      return nullptr;
+    }
+    partner = pairIndex->getPartner(token);
+  }
+  if (partner != nullptr && !global &&
+      (partner->lno < (size_t)ei.TopScreenLine || partner->lno >= (size_t)(ei.TopScreenLine + ei.WindowSizeY))) {
+    // searchLocalPair looks only at the visible lines
+    partner = nullptr;
+  }
+
+  // region lookup can parse text and move tokens
+  PairToken stoken = *token;
+  PairToken ptoken;
+  if (partner != nullptr) {
+    ptoken = *partner;
+  }
+  LineRegion* start = pairIndex->getLineRegion(&stoken);
+  if (start == nullptr) {
+    return nullptr;
+  }
+  PairMatch* pm = new PairMatch(start, (int)lno, stoken.open);
+  if (partner != nullptr) {
+    LineRegion* end = pairIndex->getLineRegion(&ptoken);
+    if (end != nullptr) {
+      pm->setEnd(end);
+      pm->eline = (int)ptoken.lno;
+      pm->pairBalance = 0;
+    }
+  }
+  return pm;
+}
+
+const LineRegion* FarEditor::getCursorRegion(const EditorInfo &ei, intptr_t lineLength)
+{
+  if (!fullBackground && ei.CurPos > lineLength) {
+    return nullptr;
+  }
+  cursorIndex.build(baseEditor->getLineRegions((int)ei.CurLine));
+  return cursorIndex.innermost((int)ei.CurPos);
+}
+
 EditorInfo FarEditor::enterHandler()
 {
   EditorInfo ei = {0};
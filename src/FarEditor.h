@@ -5,8 +5,14 @@
 #include <colorer/handlers/StyledRegion.h>
 #include <colorer/editor/Outliner.h>
 #include "pcolorer.h"
+#include "ParseDocument.h"
+#include "LineRegionIndex.h"
+#include "TokenStream.h"
+#include "TypeParams.h"
 
 const intptr_t CurrentEditor = -1;
+/** Lines parsed at first when the pair end is searched below the parsed text */
+const size_t cPairParseStep = 2000;
 const DString DDefaultScheme = DString("default");
 const DString DShowCross    = DString("show-cross");
 const DString DNone         = DString("none");
@@ -27,6 +33,8 @@ const DString DDefBack      = DString("default-back");
 const DString DFullback     = DString("fullback");
 const DString DHotkey       = DString("hotkey");
 const DString DFavorite     = DString("favorite");
+const DString DFirstLines   = DString("firstlines");
+const DString DFirstLineBytes = DString("firstlinebytes");
 
 #define revertRGB(x) (BYTE)(x>>16 & 0xff)|((BYTE)(x>>8 & 0xff)<<8)|((BYTE)(x & 0xff)<<16)
 
@@ -39,8 +47,10 @@ class FarEditor : public LineSource
 {
 public:
   /** Creates FAR editor instance.
+  If doc is given, the editor shares its parse state with the other editors of the file.
+  @param tp parameters of the types of the database, shared by editors
   */
-  FarEditor(PluginStartupInfo* info, ParserFactory* pf);
+  FarEditor(PluginStartupInfo* info, ParserFactory* pf, TypeParams* tp, std::shared_ptr<ParseDocument> doc = nullptr);
   /** Drops this editor */
   ~FarEditor();
 
@@ -61,6 +71,12 @@ public:
   /** Selects file type with it's extension and first lines
   */
   void chooseFileType(String* fname);
+  /** Hash of the start of the text, which is used for the choice of file type
+  */
+  unsigned int getTextStartHash() const;
+  /** Parses the whole text and writes its regions to the token stream
+  */
+  void exportTokens(TokenStreamWriter &writer);
 
 
   /** Installs specified RegionMapper implementation.
@@ -69,6 +85,21 @@ public:
   */
   void setRegionMapper(RegionMapper* rs);
 
+  /** Moves editor to the new HRC database.
+  Parse state is dropped, the file type is kept if the new database has it,
+  otherwise it is chosen again with fname.
+  */
+  void changeParserFactory(ParserFactory* pf, RegionMapper* rs, String* fname);
+  /** Frees parse state of the background editor, the file type is kept.
+  The text is parsed again when the editor is redrawn.
+  */
+  void dropParseState();
+  /** Parse state of the editor */
+  std::shared_ptr<ParseDocument> getDocument() const
+  {
+    return document;
+  }
+
   /**
   * Change editor properties. These overwrites default HRC settings
   */
@@ -88,6 +119,7 @@ public:
   */
   void selectBlock();
   /** Editor action: Selection of current region under cursor.
+      If the region is already selected, selects the enclosing one.
   */
   void selectRegion();
   /** Editor action: Lists fuctional region.
@@ -100,6 +132,11 @@ public:
   * Locates a function under cursor and tries to jump to it using outliner information
   */
   void locateFunction();
+  /** Editor action: moves cursor to the next or previous occurrence of the region
+      and selects it on its first line.
+      @return false if the region is unknown or not found
+  */
+  bool findRegion(const String* regionName, bool forward);
 
   /** Invalidates current syntax highlighting
   */
@@ -117,6 +154,9 @@ private:
   PluginStartupInfo* info;
 
   ParserFactory* parserFactory;
+  TypeParams* typeParams;
+  std::shared_ptr<ParseDocument> document;
+  /** parse state of the document */
   BaseEditor* baseEditor;
 
   int  maxLineLength;
@@ -149,15 +189,33 @@ private:
   int newfore;
   int newback;
   const StyledRegion* rdBackground;
-  LineRegion* cursorRegion;
+  RegionMapper* regionMapper;
+  LineRegionIndex cursorIndex;
+  std::vector<const LineRegion*> regionChain;
 
   int visibleLevel;
   Outliner* structOutliner;
   Outliner* errorOutliner;
+  PairIndex* pairIndex;
   intptr_t editor_id;
 
+  /** Creates own document with BaseEditor, outliners and pair index */
+  void createBaseEditor();
+  void attachDocument(std::shared_ptr<ParseDocument> doc);
+  /** Replaces the document with the new empty one of the same text */
+  void renewDocument();
+  /** Makes own copy of the document, if it is shared with other editors.
+      The copy is parsed again.
+  */
+  void unshareDocument();
   void reloadTypeSettings();
   EditorInfo enterHandler();
+  /** Finds pair under cursor using pairIndex.
+      Local search returns the pair end only if it is on the screen.
+  */
+  PairMatch* searchPair(const EditorInfo &ei, bool global);
+  /** Returns the innermost region under cursor. Valid until next text parsing. */
+  const LineRegion* getCursorRegion(const EditorInfo &ei, intptr_t lineLength);
   FarColor convert(const StyledRegion* rd) const;
   bool foreDefault(const FarColor &col) const;
   bool backDefault(const FarColor &col) const;
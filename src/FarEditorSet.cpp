@@ -1,7 +1,18 @@
+#include <algorithm>
+#include <unordered_set>
 #include <farcolor.hpp>
 #include "FarEditorSet.h"
 #include "tools.h"
-#include "SettingsControl.h"
+#include "SettingsCache.h"
+#include "CatalogLocations.h"
+#include "BaseLoader.h"
+#include "TypeLoader.h"
+#include "BatchColorizer.h"
+#include "RegionGrep.h"
+#include "HrdSetsReader.h"
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <unicode/Character.h>
 #include <xml/XmlParserErrorHandler.h>
 #include <colorer/handlers/FileErrorHandler.h>
 #include <colorer/ParserFactoryException.h>
@@ -10,16 +21,32 @@ FarEditorSet::FarEditorSet():
   dialogFirstFocus(false), menuid(0), sTempHrdName(nullptr), sTempHrdNameTm(nullptr), parserFactory(nullptr), regionMapper(nullptr), 
   hrcParser(nullptr), sHrdName(nullptr), sHrdNameTm(nullptr), sCatalogPath(nullptr), sUserHrdPath(nullptr), sUserHrcPath(nullptr),
   sLogPath(nullptr), sCatalogPathExp(nullptr), sUserHrdPathExp(nullptr), sUserHrcPathExp(nullptr), sLogPathExp(nullptr), 
-  CurrentMenuItem(0), err_status(ERR_NO_ERROR), error_handler(nullptr)
+  CurrentMenuItem(0), err_status(ERR_NO_ERROR)
 {
   in_construct = true;
-  xercesc::XMLPlatformUtils::Initialize();
+  startupTime = std::chrono::steady_clock::now();
+  firstColoured = false;
+  firstEditorTime = 0;
+  profileFileType = false;
+  evictionCount = 0;
+  reloadAgain = false;
+  {
+    PhaseProfiler::Phase phase(&profiler, L"XMLPlatformUtils");
+    xercesc::XMLPlatformUtils::Initialize();
+  }
   ReloadBase();
+  baseLoadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTime).count();
   in_construct = false;
 }
 
 FarEditorSet::~FarEditorSet()
 {
+  if (reloadThread.joinable()) {
+    reloadThread.join();
+  }
+  fileTypeCache.save();
+  flushSettings();
+  closedDocuments.clear();
   dropAllEditors(false);
   xercesc::XMLPlatformUtils::Terminate();
 }
@@ -27,11 +54,13 @@ FarEditorSet::~FarEditorSet()
 void FarEditorSet::openMenu(int MenuId)
 {
   if (MenuId < 0) {
-    const size_t menu_size = 13;
+    // the items are added at the end, so the macro codes of the old ones stay the same
+    const size_t menu_size = 16;
     int iMenuItems[menu_size] = {
       mListTypes, mMatchPair, mSelectBlock, mSelectPair,
       mListFunctions, mFindErrors, mSelectRegion, mCurrentRegionName, mLocateFunction, -1,
-      mUpdateHighlight, mReloadBase, mConfigure
+      mUpdateHighlight, mReloadBase, mConfigure, -1,
+      mNextRegion, mPreviousRegion
     };
     FarMenuItem menuElements[menu_size];
     memset(menuElements, 0, sizeof(menuElements));
@@ -99,6 +128,12 @@ void FarEditorSet::openMenu(int MenuId)
         case 12:
           configure(true);
           break;
+        case 14:
+          findRegion(nullptr, true);
+          break;
+        case 15:
+          findRegion(nullptr, false);
+          break;
       }
     } catch (Exception &e) {
       if (getErrorHandler()) {
@@ -121,11 +156,11 @@ void FarEditorSet::viewFile(const String &path)
       throw Exception(DString("FarColorer is disabled"));
     }
 
-    // Creates store of text lines
-    TextLinesStore textLinesStore;
-    textLinesStore.loadFile(&path, nullptr, true);
+    // Maps the file, lines are indexed in background
+    MappedTextStore textStore;
+    textStore.open(&path, true);
     // Base editor to make primary parse
-    BaseEditor baseEditor(parserFactory.get(), &textLinesStore);
+    BaseEditor baseEditor(parserFactory.get(), &textStore);
     RegionMapper* regionMap;
     try {
       regionMap = parserFactory->createStyledMapper(&DConsole, sHrdName.get());
@@ -136,9 +171,13 @@ void FarEditorSet::viewFile(const String &path)
       regionMap = parserFactory->createStyledMapper(&DConsole, nullptr);
     }
     baseEditor.setRegionMapper(regionMap);
+    // the first lines are used for the choice of type
+    int chooseLines = defaultType ? typeParams.getValueInt(defaultType, TP_FIRSTLINES) : 4;
+    textStore.waitForLines(chooseLines);
+    baseEditor.lineCountEvent((int)textStore.getLineCount());
     baseEditor.chooseFileType(&path);
-    // initial event
-    baseEditor.lineCountEvent((int)textLinesStore.getLineCount());
+    // parsing starts near the visible lines, if they are far from the top
+    baseEditor.setBackParse(typeParams.getValueInt(baseEditor.getFileType(), TP_BACKPARSE));
     // computing background color
     int background = 0x1F;
     const StyledRegion* rd = StyledRegion::cast(regionMap->getRegionDefine(DString("def:Text")));
@@ -148,7 +187,7 @@ void FarEditorSet::viewFile(const String &path)
     }
 
     // File viewing in console window
-    TextConsoleViewer viewer(&baseEditor, &textLinesStore, background, -1);
+    MappedTextViewer viewer(&baseEditor, &textStore, background);
     viewer.view();
     delete regionMap;
   } catch (Exception &e) {
@@ -156,78 +195,382 @@ void FarEditorSet::viewFile(const String &path)
   }
 }
 
-size_t FarEditorSet::getCountFileTypeAndGroup() const
+/** Splits command line arguments, they are separated by spaces, quoted ones can contain spaces */
+static void splitArguments(const wchar_t* args, std::vector<std::wstring> &argv)
 {
-  size_t num = 0;
-  const String* group = nullptr;
-  FileType* type = nullptr;
+  for (const wchar_t* p = args; *p;) {
+    while (*p == L' ') {
+      p++;
+    }
+    if (!*p) {
+      break;
+    }
+    std::wstring arg;
+    bool quoted = false;
+    while (*p && (quoted || *p != L' ')) {
+      if (*p == L'"') {
+        quoted = !quoted;
+      } else {
+        arg += *p;
+      }
+      p++;
+    }
+    argv.push_back(arg);
+  }
+}
 
-  for (int idx = 0;; idx++, num++) {
-    type = hrcParser->enumerateFileTypes(idx);
+void FarEditorSet::colorizeFiles(const wchar_t* args)
+{
+  try {
+    if (!rEnabled) {
+      throw Exception(DString("FarColorer is disabled"));
+    }
 
-    if (type == nullptr) {
-      break;
+    std::vector<std::wstring> argv;
+    splitArguments(args, argv);
+    if (argv.size() < 3) {
+      throw Exception(DString("Usage: -batch html|ansi|tokens <output folder> <files>"));
+    }
+
+    BatchColorizer::OutputFormat format;
+    if (_wcsicmp(argv[0].c_str(), L"html") == 0) {
+      format = BatchColorizer::OF_HTML;
+    } else if (_wcsicmp(argv[0].c_str(), L"ansi") == 0) {
+      format = BatchColorizer::OF_ANSI;
+    } else if (_wcsicmp(argv[0].c_str(), L"tokens") == 0) {
+      format = BatchColorizer::OF_TOKENS;
+    } else {
+      throw Exception(DString("Unknown output format, html, ansi or tokens expected"));
+    }
+    std::unique_ptr<SString> outDir(PathToFullS(argv[1].c_str(), false));
+    if (outDir == nullptr) {
+      throw Exception(DString("Output folder is not set"));
+    }
+
+    BatchColorizer colorizer(sCatalogPathExp.get(), sUserHrcPathExp.get(), format == BatchColorizer::OF_HTML ? sHrdNameTm.get() : sHrdName.get(),
+                             format, getErrorHandler());
+    const wchar_t* ext = format == BatchColorizer::OF_HTML ? L".html" : format == BatchColorizer::OF_ANSI ? L".ans" : L".ctok";
+    // lowercased paths: a file is colorized once, and the files of the same name from
+    // different folders get a counter in the output name
+    std::unordered_set<std::wstring> inputs;
+    std::unordered_set<std::wstring> outputs;
+    for (size_t i = 2; i < argv.size(); i++) {
+      std::unique_ptr<SString> mask(PathToFullS(argv[i].c_str(), false));
+      if (mask == nullptr) {
+        continue;
+      }
+      std::wstring dir(mask->getWChars());
+      dir.resize(dir.find_last_of(L'\\') + 1);
+      WIN32_FIND_DATAW fd;
+      HANDLE find = FindFirstFileW(mask->getWChars(), &fd);
+      if (find == INVALID_HANDLE_VALUE) {
+        continue;
+      }
+      do {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+          continue;
+        }
+        std::wstring input = dir + fd.cFileName;
+        std::wstring key(input);
+        CharLowerBuffW(&key[0], static_cast<DWORD>(key.length()));
+        if (!inputs.insert(key).second) {
+          continue;
+        }
+        std::wstring name(fd.cFileName);
+        for (int n = 2;; n++) {
+          key = name + ext;
+          CharLowerBuffW(&key[0], static_cast<DWORD>(key.length()));
+          if (outputs.insert(key).second) {
+            break;
+          }
+          wchar_t counter[16];
+          _snwprintf(counter, 16, L"~%d", n);
+          counter[15] = 0;
+          name = std::wstring(fd.cFileName) + counter;
+        }
+        std::wstring output = std::wstring(outDir->getWChars()) + L"\\" + name + ext;
+        colorizer.add(DString(input.c_str()), DString(output.c_str()));
+      } while (FindNextFileW(find, &fd));
+      FindClose(find);
+    }
+    if (!colorizer.count()) {
+      throw Exception(DString("No files found"));
     }
 
-    if (group != nullptr && !group->equals(type->getGroup())) {
-      num++;
+    size_t threads = std::thread::hardware_concurrency();
+    if (threads == 0) {
+      threads = 1;
+    }
+    colorizer.start(threads);
+
+    const wchar_t* marr[3] = { GetMsg(mName), nullptr, nullptr };
+    wchar_t progress[64];
+    marr[1] = progress;
+    while (!colorizer.wait(200)) {
+      _snwprintf(progress, 64, GetMsg(mBatchProgress), (int)colorizer.done(), (int)colorizer.count());
+      progress[63] = 0;
+      HANDLE scr = Info.SaveScreen(0, 0, -1, -1);
+      Info.Message(&MainGuid, &ReloadBaseMessage, 0, nullptr, &marr[0], 2, 0);
+      Info.RestoreScreen(scr);
     }
 
-    group = type->getGroup();
+    double mb = colorizer.bytes() / (1024.0 * 1024.0);
+    double seconds = colorizer.getTime() / 1000;
+    wchar_t done[128];
+    _snwprintf(done, 128, GetMsg(mBatchDone), (int)(colorizer.done() - colorizer.failed()), mb, seconds,
+               seconds > 0 ? mb / seconds : 0.0);
+    done[127] = 0;
+    marr[1] = done;
+    if (getErrorHandler() != nullptr) {
+      getErrorHandler()->warning(DString(done));
+    }
+    size_t lines = 2;
+    wchar_t failed[64];
+    if (colorizer.failed()) {
+      _snwprintf(failed, 64, GetMsg(mBatchFailed), (int)colorizer.failed());
+      failed[63] = 0;
+      marr[2] = failed;
+      lines = 3;
+      if (getErrorHandler() != nullptr && colorizer.getError() != nullptr) {
+        getErrorHandler()->error(*colorizer.getError());
+      }
+    }
+    Info.Message(&MainGuid, &ReloadBaseMessage, FMSG_MB_OK | FMSG_LEFTALIGN, nullptr, &marr[0], lines, 0);
+  } catch (Exception &e) {
+    showExceptionMessage(e.getMessage()->getWChars());
   }
-  return num;
 }
 
-FileTypeImpl* FarEditorSet::getFileTypeByIndex(int idx) const
+bool FarEditorSet::findRegion(const wchar_t* regionName, bool forward)
 {
-  FileType* type = nullptr;
-  const String* group = nullptr;
-
-  for (int i = 0; idx >= 0; idx--, i++) {
-    type = hrcParser->enumerateFileTypes(i);
+  if (!rEnabled) {
+    return false;
+  }
+  FarEditor* editor = getCurrentEditor();
+  if (editor == nullptr) {
+    return false;
+  }
 
-    if (!type) {
-      break;
+  wchar_t name[256];
+  if (regionName == nullptr) {
+    // the last searched region is taken from the history
+    if (!Info.InputBox(&MainGuid, &RegionSearchInput, GetMsg(mFindRegion), GetMsg(mFindRegionName), L"ColorerRegionSearch", L"",
+                       name, 256, L"menu", FIB_BUTTONS)) {
+      return false;
     }
+    if (!name[0]) {
+      return false;
+    }
+  }
+
+  DString dname(regionName != nullptr ? regionName : name);
+  bool found = editor->findRegion(&dname, forward);
+  if (!found && regionName == nullptr) {
+    const wchar_t* msg[2] = { GetMsg(mNothingFound), GetMsg(mGotcha) };
+    Info.Message(&MainGuid, &NothingFoundMesage, 0, nullptr, msg, 2, 1);
+  }
+  return found;
+}
+
+bool FarEditorSet::exportTokens(const wchar_t* path)
+{
+  if (!rEnabled) {
+    return false;
+  }
+  FarEditor* editor = getCurrentEditor();
+  if (editor == nullptr) {
+    return false;
+  }
+  std::unique_ptr<SString> fileName(PathToFullS(path, false));
+  if (fileName == nullptr) {
+    return false;
+  }
 
-    if (group != nullptr && !group->equals(type->getGroup())) {
-      idx--;
+  try {
+    TokenStreamWriter writer;
+    editor->exportTokens(writer);
+    writer.save(fileName.get());
+  } catch (Exception &e) {
+    if (getErrorHandler() != nullptr) {
+      getErrorHandler()->error(*e.getMessage());
     }
-    group = type->getGroup();
+    return false;
+  }
+  return true;
+}
+
+/** Adds the files of the mask in the folder and in its subfolders */
+static void findFiles(const std::wstring &dir, const wchar_t* mask, RegionGrep &grep)
+{
+  WIN32_FIND_DATAW fd;
+  HANDLE find = FindFirstFileW((dir + mask).c_str(), &fd);
+  if (find != INVALID_HANDLE_VALUE) {
+    do {
+      if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        grep.add(DString((dir + fd.cFileName).c_str()));
+      }
+    } while (FindNextFileW(find, &fd));
+    FindClose(find);
   }
 
-  return static_cast<FileTypeImpl*>(type);
+  find = FindFirstFileW((dir + L"*").c_str(), &fd);
+  if (find == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  do {
+    // links are skipped, they can make a loop
+    if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && !(fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
+        wcscmp(fd.cFileName, L".") && wcscmp(fd.cFileName, L"..")) {
+      findFiles(dir + fd.cFileName + L"\\", mask, grep);
+    }
+  } while (FindNextFileW(find, &fd));
+  FindClose(find);
 }
 
-void FarEditorSet::FillTypeMenu(ChooseTypeMenu* Menu, FileType* CurFileType) const
+void FarEditorSet::grepFiles(const wchar_t* args)
 {
-  const String* group = nullptr;
-  FileType* type = nullptr;
+  try {
+    if (!rEnabled) {
+      throw Exception(DString("FarColorer is disabled"));
+    }
+
+    std::vector<std::wstring> argv;
+    splitArguments(args, argv);
+    bool ignoreCase = false;
+    std::vector<std::wstring> inRegions;
+    std::vector<std::wstring> notRegions;
+    size_t arg = 0;
+    for (; arg < argv.size(); arg++) {
+      if (argv[arg] == L"-i") {
+        ignoreCase = true;
+      } else if ((argv[arg] == L"-in" || argv[arg] == L"-not") && arg + 1 < argv.size()) {
+        // comma separated region names
+        std::vector<std::wstring> &regions = argv[arg] == L"-in" ? inRegions : notRegions;
+        std::wstring &names = argv[++arg];
+        for (size_t start = 0; start < names.length();) {
+          size_t end = names.find(L',', start);
+          if (end == std::wstring::npos) {
+            end = names.length();
+          }
+          if (end > start) {
+            regions.push_back(names.substr(start, end - start));
+          }
+          start = end + 1;
+        }
+      } else {
+        break;
+      }
+    }
+    if (argv.size() < arg + 2) {
+      throw Exception(DString("Usage: -grep [-i] [-in <regions>] [-not <regions>] <expression> <files>"));
+    }
 
-  group = &DAutodetect;
+    RegionGrep grep(sCatalogPathExp.get(), sUserHrcPathExp.get(), argv[arg].c_str(), ignoreCase, inRegions, notRegions,
+                    getErrorHandler());
+    for (size_t i = arg + 1; i < argv.size(); i++) {
+      std::unique_ptr<SString> mask(PathToFullS(argv[i].c_str(), false));
+      if (mask == nullptr) {
+        continue;
+      }
+      std::wstring path(mask->getWChars());
+      size_t name = path.find_last_of(L'\\') + 1;
+      findFiles(path.substr(0, name), path.c_str() + name, grep);
+    }
+    if (!grep.count()) {
+      throw Exception(DString("No files found"));
+    }
 
-  for (int idx = 0;; idx++) {
-    type = hrcParser->enumerateFileTypes(idx);
+    size_t threads = std::thread::hardware_concurrency();
+    if (threads == 0) {
+      threads = 1;
+    }
+    grep.start(threads);
+
+    const wchar_t* marr[2] = { GetMsg(mName), nullptr };
+    wchar_t progress[64];
+    marr[1] = progress;
+    while (!grep.wait(200)) {
+      _snwprintf(progress, 64, GetMsg(mGrepProgress), (int)grep.done(), (int)grep.count(), (int)grep.matches());
+      progress[63] = 0;
+      HANDLE scr = Info.SaveScreen(0, 0, -1, -1);
+      Info.Message(&MainGuid, &ReloadBaseMessage, 0, nullptr, &marr[0], 2, 0);
+      Info.RestoreScreen(scr);
+    }
+    if (grep.getError() != nullptr) {
+      // files are skipped after the error, it is fatal if the search is not done
+      if (grep.done() < grep.count()) {
+        throw Exception(*grep.getError());
+      }
+      if (getErrorHandler() != nullptr) {
+        getErrorHandler()->error(*grep.getError());
+      }
+    }
 
-    if (type == nullptr) {
-      break;
+    std::vector<RegionGrep::Match> matches;
+    grep.takeMatches(matches);
+    if (matches.empty()) {
+      const wchar_t* msg[2] = { GetMsg(mNothingFound), GetMsg(mGotcha) };
+      Info.Message(&MainGuid, &NothingFoundMesage, 0, nullptr, msg, 2, 1);
+      return;
+    }
+    // files are done in any order
+    std::sort(matches.begin(), matches.end(), [](const RegionGrep::Match & a, const RegionGrep::Match & b) {
+      return a.file < b.file || (a.file == b.file && (a.lno < b.lno || (a.lno == b.lno && a.pos < b.pos)));
+    });
+    if (matches.size() > cGrepResultsMax) {
+      matches.resize(cGrepResultsMax);
     }
 
-    if (group != nullptr && !group->equals(type->getGroup())) {
-      Menu->AddGroup(type->getGroup()->getWChars());
-      group = type->getGroup();
+    std::vector<std::wstring> texts(matches.size());
+    std::vector<FarMenuItem> items(matches.size());
+    for (size_t i = 0; i < matches.size(); i++) {
+      const RegionGrep::Match &match = matches[i];
+      wchar_t lno[32];
+      _snwprintf(lno, 32, L":%Iu: ", match.lno + 1);
+      lno[31] = 0;
+      texts[i] = grep.getFileName(match.file)->getWChars();
+      texts[i] += lno;
+      size_t start = match.line.find_first_not_of(L" \t");
+      if (start != std::wstring::npos) {
+        texts[i] += match.line.substr(start);
+      }
+      std::replace(texts[i].begin(), texts[i].end(), L'\t', L' ');
+      memset(&items[i], 0, sizeof(FarMenuItem));
+      items[i].Text = texts[i].c_str();
     }
 
-    size_t i;
-    const String* v;
-    v = static_cast<FileTypeImpl*>(type)->getParamValue(DFavorite);
-    if (v && v->equals(&DTrue)) {
-      i = Menu->AddFavorite(type);
-    } else {
-      i = Menu->AddItem(type);
+    wchar_t bottom[64];
+    _snwprintf(bottom, 64, GetMsg(mGrepTotal), (int)grep.matches(), (int)grep.count());
+    bottom[63] = 0;
+    intptr_t i = Info.Menu(&MainGuid, &GrepResultMenu, -1, -1, 0, FMENU_WRAPMODE | FMENU_SHOWAMPERSAND, argv[arg].c_str(), bottom,
+                           L"cmdline", nullptr, nullptr, items.data(), items.size());
+    if (i >= 0) {
+      const RegionGrep::Match &match = matches[i];
+      Info.Editor(grep.getFileName(match.file)->getWChars(), nullptr, 0, 0, -1, -1, EF_NONMODAL | EF_IMMEDIATERETURN,
+                  match.lno + 1, match.pos + 1, CP_DEFAULT);
     }
-    if (type == CurFileType) {
-      Menu->SetSelected(i);
+  } catch (Exception &e) {
+    showExceptionMessage(e.getMessage()->getWChars());
+  }
+}
+
+void FarEditorSet::FillTypeMenu(ChooseTypeMenu* Menu)
+{
+  const std::vector<FileType*> &types = typeCatalog.getTypes();
+  const std::vector<TypeCatalog::Group> &groups = typeCatalog.getGroups();
+
+  for (size_t g = 0; g < groups.size(); g++) {
+    Menu->AddGroup(groups[g].name != nullptr ? groups[g].name->getWChars() : L"");
+    size_t end = g + 1 < groups.size() ? groups[g + 1].start : types.size();
+    for (size_t idx = groups[g].start; idx < end; idx++) {
+      FileType* type = types[idx];
+      const String* v;
+      v = typeParams.getValue(type, TP_FAVORITE);
+      if (v && v->equals(&DTrue)) {
+        Menu->AddFavorite(type);
+      } else {
+        Menu->AddItem(type);
+      }
     }
   }
 
@@ -274,18 +617,118 @@ void FarEditorSet::chooseType()
     return;
   }
 
-  ChooseTypeMenu menu(GetMsg(mAutoDetect), GetMsg(mFavorites));
-  FillTypeMenu(&menu, fe->getFileType());
+  // the menu is built once for the database, it keeps the changes of favorites and hotkeys
+  if (!typeMenu) {
+    typeMenu.reset(new ChooseTypeMenu(GetMsg(mAutoDetect), GetMsg(mFavorites), &typeParams));
+    FillTypeMenu(typeMenu.get());
+  }
+  ChooseTypeMenu &menu = *typeMenu;
+  menu.SetSelected(menu.FindFileType(fe->getFileType()));
 
   wchar_t bottom[20];
   _snwprintf(bottom, 20, GetMsg(mTotalTypes), hrcParser->getFileTypesCount());
-  struct FarKey BreakKeys[3] = {VK_INSERT, 0, VK_DELETE, 0, VK_F4, 0};
+  const int FILTER_SIZE = 40;
+  const struct FarKey CommandKeys[] = {
+    {VK_INSERT, 0}, {VK_DELETE, 0}, {VK_F4, 0}, {VK_BACK, 0}, {VK_SPACE, 0}, {VK_OEM_MINUS, 0}
+  };
+  // letters and digits are added for each call of the menu
+  std::vector<FarKey> BreakKeys;
+  BreakKeys.reserve(ARRAY_SIZE(CommandKeys) + 36 + 1);
   intptr_t BreakCode;
+
+  wchar_t filter[FILTER_SIZE + 1];
+  int flen = 0;
+  *filter = 0;
+  wchar_t title[128];
+  FuzzyMatcher &matcher = typeCatalog.getMatcher();
+  // items of the filtered menu with the indexes in the full menu, reused for each key
+  std::vector<FarMenuItem> filtered;
+  std::vector<std::pair<int, size_t>> ranked;
+  std::vector<int> scores;
+  filtered.reserve(menu.getItemsCount());
+  ranked.reserve(menu.getItemsCount());
+  FileType* selectedType = fe->getFileType();
+
   while (1) {
+    FarMenuItem* items = menu.getItems();
+    size_t items_count = menu.getItemsCount();
+    const wchar_t* caption = GetMsg(mSelectSyntax);
+
+    // while the filter is empty, the hotkeys of the types are left to the menu,
+    // the other letters and digits start the filter
+    bool hotkeys[36] = {false};
+    if (flen == 0) {
+      for (size_t k = 0; k < items_count; k++) {
+        FileType* type = menu.GetFileType(k);
+        const String* hotkey = type != nullptr ? typeParams.getValue(type, TP_HOTKEY) : nullptr;
+        if (hotkey == nullptr || hotkey->length() != 1) {
+          continue;
+        }
+        wchar_t c = Character::toUpperCase((*hotkey)[0]);
+        if (c >= '0' && c <= '9') {
+          hotkeys[c - '0'] = true;
+        } else if (c >= 'A' && c <= 'Z') {
+          hotkeys[c - 'A' + 10] = true;
+        }
+      }
+    }
+    BreakKeys.assign(CommandKeys, CommandKeys + ARRAY_SIZE(CommandKeys));
+    for (int k = 0; k < 36; k++) {
+      if (!hotkeys[k]) {
+        FarKey key = { static_cast<WORD>(k < 10 ? '0' + k : 'A' + k - 10), 0 };
+        BreakKeys.push_back(key);
+      }
+    }
+    FarKey last_key = { 0, 0 };
+    BreakKeys.push_back(last_key);
+
+    if (flen > 0) {
+      matcher.match(filter, scores);
+      ranked.clear();
+      for (size_t k = 0; k < items_count; k++) {
+        FileType* type = menu.GetFileType(k);
+        size_t idx = type != nullptr ? typeCatalog.getTypeIndex(type) : SIZE_MAX;
+        if (idx == SIZE_MAX || scores[idx] < 0) {
+          continue;
+        }
+        ranked.push_back(std::make_pair(scores[idx], k));
+      }
+      if (ranked.empty()) {
+        filter[--flen] = 0;
+        continue;
+      }
+      std::stable_sort(ranked.begin(), ranked.end(), [](const std::pair<int, size_t> &a, const std::pair<int, size_t> &b) {
+        return a.first > b.first;
+      });
+
+      filtered.clear();
+      size_t selected = 0;
+      for (size_t r = 0; r < ranked.size(); r++) {
+        FarMenuItem item = items[ranked[r].second];
+        item.Flags &= ~(MIF_SELECTED | MIF_HIDDEN);
+        if (menu.GetFileType(ranked[r].second) == selectedType) {
+          selected = r;
+        }
+        filtered.push_back(item);
+      }
+      filtered[selected].Flags |= MIF_SELECTED;
+      items = filtered.data();
+      items_count = filtered.size();
+
+      _snwprintf(title, 128, L"%s [%s]", caption, filter);
+      caption = title;
+    }
+
     intptr_t i = Info.Menu(&MainGuid, &FileChooseMenu, -1, -1, 0, FMENU_WRAPMODE | FMENU_AUTOHIGHLIGHT,
-                           GetMsg(mSelectSyntax), bottom, L"filetypechoose", BreakKeys, &BreakCode, menu.getItems(), menu.getItemsCount());
+                           caption, bottom, L"filetypechoose", BreakKeys.data(), &BreakCode, items, items_count);
 
     if (i >= 0) {
+      // index in the full menu
+      if (flen > 0) {
+        i = ranked[i].second;
+      }
+      selectedType = menu.GetFileType(i);
+
       if (BreakCode == 0) {
         if (i != 0 && !menu.IsFavorite(i)) {
           menu.MoveToFavorites(i);
@@ -311,7 +754,7 @@ void FarEditorSet::chooseType()
         };
 
         const String* v;
-        v = static_cast<FileTypeImpl*>(menu.GetFileType(i))->getParamValue(DHotkey);
+        v = typeParams.getValue(menu.GetFileType(i), TP_HOTKEY);
         if (v && v->length()) {
           KeyAssignDlgData[2].Data = v->getWChars();
         }
@@ -326,10 +769,26 @@ void FarEditorSet::chooseType()
           }
           DString hotkey = DString(KeyAssignDlgData[2].Data);
           menu.GetFileType(i)->setParamValue(DHotkey, &hotkey);
+          typeParams.invalidate(menu.GetFileType(i));
           menu.RefreshItemCaption(i);
         }
         menu.SetSelected(i);
         Info.DialogFree(hDlg);
+      } else if (BreakCode == 3) { // VK_BACK
+        if (flen > 0) {
+          filter[--flen] = 0;
+        }
+        menu.SetSelected(i);
+      } else if (BreakCode > 3 && BreakCode + 1 < (intptr_t)BreakKeys.size()) {
+        if (flen < FILTER_SIZE) {
+          wchar_t c = static_cast<wchar_t>(BreakKeys[BreakCode].VirtualKeyCode);
+          if (c == VK_OEM_MINUS) {
+            c = '-';
+          }
+          filter[flen] = static_cast<wchar_t>(Character::toLowerCase(c));
+          filter[++flen] = 0;
+        }
+        menu.SetSelected(i);
       } else {
         if (i == 0) {
           String* s = getCurrentFileName();
@@ -345,8 +804,9 @@ void FarEditorSet::chooseType()
     }
   }
 
-  FarHrcSettings p(parserFactory.get());
+  FarHrcSettings p(parserFactory.get(), &settingsCache);
   p.writeUserProfile();
+  flushSettings();
 }
 
 const String* FarEditorSet::getHRDescription(const String &name, const DString &_hrdClass) const
@@ -433,7 +893,7 @@ void FarEditorSet::configure(bool fromEditor)
   try {
     FarDialogItem fdi[] = {
       // type, x1, y1, x2, y2, param, history, mask, flags,  data, maxlen,userdata
-      { DI_DOUBLEBOX, 3, 1, 55, 25, 0, nullptr, nullptr, 0, nullptr, 0, 0},     //IDX_BOX,
+      { DI_DOUBLEBOX, 3, 1, 55, 26, 0, nullptr, nullptr, 0, nullptr, 0, 0},     //IDX_BOX,
       { DI_CHECKBOX, 5, 2, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},        //IDX_DISABLED,
       { DI_CHECKBOX, 5, 3, 0, 0, 0, nullptr, nullptr, DIF_3STATE, nullptr, 0, 0}, //IDX_CROSS,
       { DI_TEXT, 7, 4, 0, 4, 0, nullptr, nullptr, 0, nullptr, 0, 0},            //IDX_CROSS_TEXT,
@@ -452,15 +912,17 @@ void FarEditorSet::configure(bool fromEditor)
       { DI_EDIT, 6, 15, 52, 15, 0, L"userhrd", nullptr, DIF_HISTORY, nullptr, 0, 0}, //IDX_USERHRD_EDIT
       { DI_TEXT, 5, 16, 0, 16, 0, nullptr, nullptr, 0, nullptr, 0, 0},          //IDX_LOG,
       { DI_EDIT, 6, 17, 52, 17, 0, L"log", nullptr, DIF_HISTORY, nullptr, 0, 0}, //IDX_LOG_EDIT
-      { DI_SINGLEBOX, 4, 18, 54, 18, 0, nullptr, nullptr, 0, nullptr, 0, 0},    //IDX_TM_BOX,
-      { DI_CHECKBOX, 5, 19, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},       //IDX_TRUEMOD,
-      { DI_TEXT, 5, 20, 0, 20, 0, nullptr, nullptr, 0, nullptr, 0, 0},          //IDX_HRD_TM,
-      { DI_BUTTON, 20, 20, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},        //IDX_HRD_SELECT_TM,
-      { DI_SINGLEBOX, 4, 21, 54, 21, 0, nullptr, nullptr, 0, nullptr, 0, 0},    //IDX_TM_BOX_OFF,
-      { DI_BUTTON, 5, 22, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},         //IDX_RELOAD_ALL,
-      { DI_BUTTON, 30, 22, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},        //IDX_HRC_SETTING,
-      { DI_BUTTON, 35, 23, 0, 0, 0, nullptr, nullptr, DIF_DEFAULTBUTTON, nullptr, 0, 0}, //IDX_OK,
-      { DI_BUTTON, 45, 23, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},        //IDX_CANCEL,
+      { DI_TEXT, 5, 18, 0, 18, 0, nullptr, nullptr, 0, nullptr, 0, 0},          //IDX_MEMORY,
+      { DI_FIXEDIT, 47, 18, 52, 18, 0, nullptr, L"999999", DIF_MASKEDIT, nullptr, 0, 0}, //IDX_MEMORY_EDIT,
+      { DI_SINGLEBOX, 4, 19, 54, 19, 0, nullptr, nullptr, 0, nullptr, 0, 0},    //IDX_TM_BOX,
+      { DI_CHECKBOX, 5, 20, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},       //IDX_TRUEMOD,
+      { DI_TEXT, 5, 21, 0, 21, 0, nullptr, nullptr, 0, nullptr, 0, 0},          //IDX_HRD_TM,
+      { DI_BUTTON, 20, 21, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},        //IDX_HRD_SELECT_TM,
+      { DI_SINGLEBOX, 4, 22, 54, 22, 0, nullptr, nullptr, 0, nullptr, 0, 0},    //IDX_TM_BOX_OFF,
+      { DI_BUTTON, 5, 23, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},         //IDX_RELOAD_ALL,
+      { DI_BUTTON, 30, 23, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},        //IDX_HRC_SETTING,
+      { DI_BUTTON, 35, 24, 0, 0, 0, nullptr, nullptr, DIF_DEFAULTBUTTON, nullptr, 0, 0}, //IDX_OK,
+      { DI_BUTTON, 45, 24, 0, 0, 0, nullptr, nullptr, 0, nullptr, 0, 0},        //IDX_CANCEL,
     };//type, x1, y1, x2, y2, param, history, mask, flags,  data, maxlen,userdata
 
     fdi[IDX_BOX].Data = GetMsg(mSetup);
@@ -518,11 +980,16 @@ void FarEditorSet::configure(bool fromEditor)
 
     fdi[IDX_LOG].Data = GetMsg(mLog);
     fdi[IDX_LOG_EDIT].Data = sLogPath->getWChars();
+    wchar_t budget[16];
+    _snwprintf(budget, 16, L"%d", memoryBudget);
+    budget[15] = 0;
+    fdi[IDX_MEMORY].Data = GetMsg(mMemoryBudget);
+    fdi[IDX_MEMORY_EDIT].Data = budget;
 
     /*
     * Dialog activation
     */
-    HANDLE hDlg = Info.DialogInit(&MainGuid, &PluginConfig, -1, -1, 58, 25, L"config", fdi, ARRAY_SIZE(fdi), 0, 0, SettingDialogProc, this);
+    HANDLE hDlg = Info.DialogInit(&MainGuid, &PluginConfig, -1, -1, 58, 26, L"config", fdi, ARRAY_SIZE(fdi), 0, 0, SettingDialogProc, this);
     intptr_t i = Info.DialogRun(hDlg);
 
     if (i == IDX_OK) {
@@ -548,6 +1015,10 @@ void FarEditorSet::configure(bool fromEditor)
       drawSyntax = !!Info.SendDlgMessage(hDlg, DM_GETCHECK, IDX_SYNTAX, nullptr);
       oldOutline = !!Info.SendDlgMessage(hDlg, DM_GETCHECK, IDX_OLDOUTLINE, nullptr);
       ChangeBgEditor = !!Info.SendDlgMessage(hDlg, DM_GETCHECK, IDX_CHANGE_BG, nullptr);
+      memoryBudget = _wtoi(trim(reinterpret_cast<wchar_t*>(Info.SendDlgMessage(hDlg, DM_GETCONSTTEXTPTR, IDX_MEMORY_EDIT, nullptr))));
+      if (memoryBudget < 0) {
+        memoryBudget = 0;
+      }
       fdi[IDX_TRUEMOD].Selected = !!Info.SendDlgMessage(hDlg, DM_GETCHECK, IDX_TRUEMOD, nullptr);
       sHrdName = std::move(sTempHrdName);
       sHrdNameTm = std::move(sTempHrdNameTm);
@@ -636,6 +1107,15 @@ const SString FarEditorSet::chooseHRDName(const String* current, const DString &
 
 int FarEditorSet::editorInput(const INPUT_RECORD &Rec)
 {
+  // changed settings are written and the memory budget is checked when the editor is idle
+  if (Rec.EventType == KEY_EVENT && Rec.Event.KeyEvent.wVirtualKeyCode == 0) {
+    if (settingsCache.isChanged()) {
+      flushSettings();
+    }
+    if (rEnabled) {
+      applyMemoryBudget(getCurrentEditor());
+    }
+  }
   if (rEnabled) {
     FarEditor* editor = getCurrentEditor();
     if (editor) {
@@ -666,7 +1146,13 @@ int FarEditorSet::editorEvent(const struct ProcessEditorEventInfo* pInfo)
           editor = addCurrentEditor();
         }
         if (editor) {
-          return editor->editorEvent(pInfo->Event, pInfo->Param);
+          touchEditor(pInfo->EditorID);
+          int res = editor->editorEvent(pInfo->Event, pInfo->Param);
+          if (!firstColoured) {
+            firstColoured = true;
+            logStartupTime();
+          }
+          return res;
         }
         return 0;
       }
@@ -691,8 +1177,19 @@ int FarEditorSet::editorEvent(const struct ProcessEditorEventInfo* pInfo)
       break;
       case EE_CLOSE: {
         auto it_editor = farEditorInstances.find(pInfo->EditorID);
+        if (it_editor != farEditorInstances.end()) {
+          keepClosedDocument(it_editor->second, getDocumentKey(pInfo->EditorID));
+        }
         delete it_editor->second;
         farEditorInstances.erase(pInfo->EditorID);
+        forgetEditor(pInfo->EditorID);
+        for (auto it_doc = documents.begin(); it_doc != documents.end();) {
+          if (it_doc->second.expired()) {
+            it_doc = documents.erase(it_doc);
+          } else {
+            ++it_doc;
+          }
+        }
         return 0;
       }
       break;
@@ -718,6 +1215,8 @@ bool FarEditorSet::TestLoadBase(const wchar_t* catalogPath, const wchar_t* userH
   HANDLE scr = Info.SaveScreen(0, 0, -1, -1);
   Info.Message(&MainGuid, &ReloadBaseMessage, 0, nullptr, &marr[0], 2, 0);
 
+  // the log is destroyed after the factory
+  std::shared_ptr<SyncErrorHandler> errorHandlerLocal = sync_error_handler;
   std::unique_ptr<ParserFactory> parserFactoryLocal = nullptr;
   std::unique_ptr<RegionMapper> regionMapperLocal = nullptr;
 
@@ -735,12 +1234,12 @@ bool FarEditorSet::TestLoadBase(const wchar_t* catalogPath, const wchar_t* userH
   }
 
   try {
-    parserFactoryLocal.reset(new ParserFactory(error_handler.get()));
+    parserFactoryLocal.reset(new ParserFactory(errorHandlerLocal.get()));
     parserFactoryLocal->loadCatalog(tpath.get());
     HRCParser* hrcParserLocal = parserFactoryLocal->getHRCParser();
     LoadUserHrd(userHrdPathS.get(), parserFactoryLocal.get());
     LoadUserHrc(userHrcPathS.get(), parserFactoryLocal.get());
-    FarHrcSettings p(parserFactoryLocal.get());
+    FarHrcSettings p(parserFactoryLocal.get(), &settingsCache);
     p.readProfile();
     p.readUserProfile();
 
@@ -768,27 +1267,27 @@ bool FarEditorSet::TestLoadBase(const wchar_t* catalogPath, const wchar_t* userH
 
     Info.RestoreScreen(scr);
     if (full) {
-      for (int idx = 0;; idx++) {
-        FileType* type = hrcParserLocal->enumerateFileTypes(idx);
-
-        if (type == nullptr) {
-          break;
-        }
-
-        StringBuffer tname;
-
-        if (type->getGroup() != nullptr) {
-          tname.append(type->getGroup());
-          tname.append(DString(": "));
-        }
-
-        tname.append(type->getDescription());
-        marr[1] = tname.getWChars();
+      size_t threads = std::thread::hardware_concurrency();
+      if (threads > 8) {
+        threads = 8;
+      }
+      TypeLoader loader(tpath.get(), userHrcPathS.get(), parserFactoryLocal->getErrorHandler());
+      loader.start(hrcParserLocal, threads);
+
+      // progress is shown a few times per second, not for each type
+      wchar_t progress[64];
+      marr[1] = progress;
+      while (!loader.wait(200)) {
+        _snwprintf(progress, 64, GetMsg(mLoadingTypes), (int)loader.loaded(), (int)loader.count());
         scr = Info.SaveScreen(0, 0, -1, -1);
         Info.Message(&MainGuid, &ReloadBaseMessage, 0, nullptr, &marr[0], 2, 0);
-        type->getBaseScheme();
         Info.RestoreScreen(scr);
       }
+
+      if (loader.getError() != nullptr) {
+        throw Exception(*loader.getError());
+      }
+      showLoadTimes(loader);
     }
   } catch (Exception &e) {
 
@@ -804,21 +1303,74 @@ bool FarEditorSet::TestLoadBase(const wchar_t* catalogPath, const wchar_t* userH
   return res;
 }
 
+void FarEditorSet::showLoadTimes(TypeLoader &loader)
+{
+  const std::vector<TypeLoader::TypeTime> &times = loader.getTimes();
+
+  // full report goes to the log
+  if (getErrorHandler() != nullptr) {
+    wchar_t line[256];
+    for (auto it = times.begin(); it != times.end(); ++it) {
+      _snwprintf(line, 256, L"%10.1f ms  %s", it->time, it->title->getWChars());
+      line[255] = 0;
+      getErrorHandler()->warning(DString(line));
+    }
+  }
+
+  const size_t SLOWEST_COUNT = 10;
+  size_t count = times.size() < SLOWEST_COUNT ? times.size() : SLOWEST_COUNT;
+  wchar_t lines[SLOWEST_COUNT][128];
+  const wchar_t* marr[SLOWEST_COUNT + 3];
+  wchar_t total_line[64];
+  _snwprintf(total_line, 64, GetMsg(mTotalLoadTime), (int)times.size(), loader.getElapsed() / 1000);
+  marr[0] = GetMsg(mName);
+  marr[1] = total_line;
+  marr[2] = GetMsg(mSlowestTypes);
+  for (size_t i = 0; i < count; i++) {
+    _snwprintf(lines[i], 128, L"%8.1f ms  %s", times[i].time, times[i].title->getWChars());
+    lines[i][127] = 0;
+    marr[i + 3] = lines[i];
+  }
+  Info.Message(&MainGuid, &ReloadBaseMessage, FMSG_MB_OK | FMSG_LEFTALIGN, nullptr, &marr[0], count + 3, 0);
+}
+
 void FarEditorSet::ReloadBase()
 {
+  if (reloadThread.joinable()) {
+    // previous reload is not finished yet, applyReloadedBase starts the new one
+    reloadAgain = true;
+    return;
+  }
+
   HANDLE scr = Info.SaveScreen(0, 0, -1, -1);
 
   try {
-    ReadSettings();
+    if (parserFactory == nullptr && !in_construct) {
+      profiler.clear();
+    }
+    {
+      PhaseProfiler::Phase phase(&profiler, L"ReadSettings");
+      ReadSettings();
+    }
     if (!rEnabled) {
       Info.RestoreScreen(scr);
       return;
     }
 
+    if (parserFactory != nullptr && !in_construct) {
+      startReloadBase();
+      Info.RestoreScreen(scr);
+      return;
+    }
+
     const wchar_t* marr[2] = { GetMsg(mName), GetMsg(mReloading) };
     Info.Message(&MainGuid, &ReloadBaseMessage, 0, nullptr, &marr[0], 2, 0);
+    closedDocuments.clear();
     dropAllEditors(true);
     regionMapper.release();
+    typeParams.reset(nullptr);
+    typeCatalog.reset(nullptr);
+    typeMenu.reset();
     parserFactory.release();
 
     if (TrueModOn) {
@@ -829,23 +1381,52 @@ void FarEditorSet::ReloadBase()
       hrdName = sHrdName.get();
     }
 
-    parserFactory.reset(new ParserFactory(error_handler.get()));
-    parserFactory->loadCatalog(sCatalogPathExp.get());
+    {
+      PhaseProfiler::Phase phase(&profiler, L"loadCatalog");
+      factory_error_handler = sync_error_handler;
+      parserFactory.reset(new ParserFactory(factory_error_handler.get()));
+      parserFactory->loadCatalog(sCatalogPathExp.get());
+    }
     hrcParser = parserFactory->getHRCParser();
-    LoadUserHrd(sUserHrdPathExp.get(), parserFactory.get());
-    LoadUserHrc(sUserHrcPathExp.get(), parserFactory.get());
-    FarHrcSettings p(parserFactory.get());
-    p.readProfile();
-    p.readUserProfile();
+    {
+      PhaseProfiler::Phase phase(&profiler, L"LoadUserHrd");
+      LoadUserHrd(sUserHrdPathExp.get(), parserFactory.get());
+    }
+    {
+      PhaseProfiler::Phase phase(&profiler, L"LoadUserHrc");
+      LoadUserHrc(sUserHrcPathExp.get(), parserFactory.get());
+    }
+    FarHrcSettings p(parserFactory.get(), &settingsCache);
+    {
+      PhaseProfiler::Phase phase(&profiler, L"readProfile");
+      p.readProfile();
+    }
+    {
+      PhaseProfiler::Phase phase(&profiler, L"readUserProfile");
+      p.readUserProfile();
+    }
     defaultType = static_cast<FileTypeImpl*>(hrcParser->getFileType(&DDefaultScheme));
+    typeParams.reset(defaultType);
+    typeCatalog.reset(hrcParser);
+    typeMenu.reset();
 
-    try {
-      regionMapper.reset(parserFactory->createStyledMapper(&hrdClass, &hrdName));
-    } catch (ParserFactoryException &e) {
-      if (getErrorHandler() != nullptr) {
-        getErrorHandler()->error(*e.getMessage());
+    {
+      PhaseProfiler::Phase phase(&profiler, L"createStyledMapper");
+      try {
+        regionMapper.reset(parserFactory->createStyledMapper(&hrdClass, &hrdName));
+      } catch (ParserFactoryException &e) {
+        if (getErrorHandler() != nullptr) {
+          getErrorHandler()->error(*e.getMessage());
+        }
+        regionMapper.reset(parserFactory->createStyledMapper(&hrdClass, nullptr));
       }
-      regionMapper.reset(parserFactory->createStyledMapper(&hrdClass, nullptr));
+    }
+    profileFileType = true;
+    // the choices of file types are kept between sessions, but not after the reload
+    if (in_construct) {
+      fileTypeCache.load(getBaseStamp());
+    } else {
+      fileTypeCache.clear(getBaseStamp());
     }
     //      .
     SetBgEditor();
@@ -855,6 +1436,7 @@ void FarEditorSet::ReloadBase()
       if (editor) {
         editor->editorEvent(EE_REDRAW, EEREDRAW_ALL);
       }
+      profiler.writeReport(getErrorHandler());
     }
   } catch (SettingsControlException &e) {
 
@@ -877,6 +1459,182 @@ void FarEditorSet::ReloadBase()
   Info.RestoreScreen(scr);
 }
 
+void FarEditorSet::startReloadBase()
+{
+  HrcBase* base = new HrcBase;
+  if (sCatalogPathExp) {
+    base->catalogPath.reset(new SString(*sCatalogPathExp));
+  }
+  if (sUserHrdPathExp) {
+    base->userHrdPath.reset(new SString(*sUserHrdPathExp));
+  }
+  if (sUserHrcPathExp) {
+    base->userHrcPath.reset(new SString(*sUserHrcPathExp));
+  }
+  base->trueMod = TrueModOn;
+  base->errorHandler = sync_error_handler;
+  base->hrdName.reset(new SString(TrueModOn ? *sHrdNameTm : *sHrdName));
+  for (auto fe = farEditorInstances.begin(); fe != farEditorInstances.end(); ++fe) {
+    FileType* type = fe->second->getFileType();
+    if (type != nullptr) {
+      base->preloadTypes.emplace_back(new SString(*type->getName()));
+    }
+  }
+
+  reloadedBase.reset(base);
+  reloadThread = std::thread(&FarEditorSet::buildBase, this, base);
+}
+
+void FarEditorSet::buildBase(HrcBase* base)
+{
+  PhaseProfiler* prof = &base->profiler;
+  try {
+    {
+      PhaseProfiler::Phase phase(prof, L"loadCatalog");
+      base->parserFactory.reset(new ParserFactory(base->errorHandler.get()));
+      base->parserFactory->loadCatalog(base->catalogPath.get());
+    }
+    {
+      PhaseProfiler::Phase phase(prof, L"LoadUserHrd");
+      LoadUserHrd(base->userHrdPath.get(), base->parserFactory.get());
+    }
+    {
+      PhaseProfiler::Phase phase(prof, L"LoadUserHrc");
+      LoadUserHrc(base->userHrcPath.get(), base->parserFactory.get());
+    }
+
+    const DString &hrd_class = base->trueMod ? DRgb : DConsole;
+    {
+      PhaseProfiler::Phase phase(prof, L"createStyledMapper");
+      try {
+        base->regionMapper.reset(base->parserFactory->createStyledMapper(&hrd_class, base->hrdName.get()));
+      } catch (ParserFactoryException &e) {
+        if (base->parserFactory->getErrorHandler() != nullptr) {
+          base->parserFactory->getErrorHandler()->error(*e.getMessage());
+        }
+        base->regionMapper.reset(base->parserFactory->createStyledMapper(&hrd_class, nullptr));
+      }
+    }
+
+    // schemes of the opened files are loaded here, not at the first redraw
+    PhaseProfiler::Phase phase(prof, L"preloadTypes");
+    HRCParser* hrcParserLocal = base->parserFactory->getHRCParser();
+    for (auto it = base->preloadTypes.begin(); it != base->preloadTypes.end(); ++it) {
+      FileType* type = hrcParserLocal->getFileType(it->get());
+      if (type != nullptr) {
+        type->getBaseScheme();
+      }
+    }
+  } catch (Exception &e) {
+    base->error.reset(new SString(*e.getMessage()));
+  } catch (std::exception &e) {
+    base->error.reset(new SString(DString(e.what())));
+  } catch (...) {
+    base->error.reset(new SString(DString("Unknown error while loading HRC database")));
+  }
+
+  Info.AdvControl(&MainGuid, ACTL_SYNCHRO, 0, nullptr);
+}
+
+void FarEditorSet::applyReloadedBase()
+{
+  if (!reloadThread.joinable()) {
+    return;
+  }
+  reloadThread.join();
+  std::unique_ptr<HrcBase> base(std::move(reloadedBase));
+
+  if (reloadAgain) {
+    // settings were changed during the reload, the built database can be outdated
+    reloadAgain = false;
+    ReloadBase();
+    return;
+  }
+
+  if (!rEnabled) {
+    return;
+  }
+  // on error the old database keeps working
+  if (base->error) {
+    if (getErrorHandler() != nullptr) {
+      getErrorHandler()->error(*base->error);
+    }
+    showExceptionMessage(base->error->getWChars());
+    return;
+  }
+
+  HRCParser* hrcParserLocal = base->parserFactory->getHRCParser();
+  FileTypeImpl* defaultTypeLocal = static_cast<FileTypeImpl*>(hrcParserLocal->getFileType(&DDefaultScheme));
+  if (defaultTypeLocal == nullptr) {
+    showExceptionMessage(L"No 'default' file type found");
+    return;
+  }
+
+  try {
+    FarHrcSettings p(base->parserFactory.get(), &settingsCache);
+    {
+      PhaseProfiler::Phase phase(&base->profiler, L"readProfile");
+      p.readProfile();
+    }
+    {
+      PhaseProfiler::Phase phase(&base->profiler, L"readUserProfile");
+      p.readUserProfile();
+    }
+  } catch (Exception &e) {
+    if (getErrorHandler() != nullptr) {
+      getErrorHandler()->error(*e.getMessage());
+    }
+    showExceptionMessage(e.getMessage()->getWChars());
+    return;
+  }
+
+  {
+    PhaseProfiler::Phase phase(&base->profiler, L"changeParserFactory");
+    closedDocuments.clear();
+    typeParams.reset(defaultTypeLocal);
+    typeCatalog.reset(hrcParserLocal);
+    typeMenu.reset();
+    for (auto fe = farEditorInstances.begin(); fe != farEditorInstances.end(); ++fe) {
+      String* fname = getEditorFileName(fe->first);
+      fe->second->changeParserFactory(base->parserFactory.get(), base->regionMapper.get(), fname);
+      delete fname;
+    }
+    documents.clear();
+    for (auto fe = farEditorInstances.begin(); fe != farEditorInstances.end(); ++fe) {
+      std::wstring doc_key = getDocumentKey(fe->first);
+      if (!doc_key.empty() && fe->second->getDocument()->getGeneration() == 0) {
+        documents[doc_key] = fe->second->getDocument();
+      }
+    }
+  }
+
+  // editors don't refer to the old database anymore
+  regionMapper = std::move(base->regionMapper);
+  parserFactory = std::move(base->parserFactory);
+  factory_error_handler = std::move(base->errorHandler);
+  hrcParser = hrcParserLocal;
+  defaultType = defaultTypeLocal;
+  fileTypeCache.clear(getBaseStamp());
+  if (TrueModOn) {
+    hrdClass = DRgb;
+    hrdName = sHrdNameTm.get();
+  } else {
+    hrdClass = DConsole;
+    hrdName = sHrdName.get();
+  }
+
+  profiler = std::move(base->profiler);
+  profiler.writeReport(getErrorHandler());
+
+  SetBgEditor();
+  Info.EditorControl(CurrentEditor, ECTL_REDRAW, 0, nullptr);
+}
+
+void FarEditorSet::getProfileReport(StringBuffer &report) const
+{
+  profiler.getReport(report);
+}
+
 colorer::ErrorHandler* FarEditorSet::getErrorHandler() const
 {
   if (parserFactory == nullptr) {
@@ -886,6 +1644,20 @@ colorer::ErrorHandler* FarEditorSet::getErrorHandler() const
   return parserFactory->getErrorHandler();
 }
 
+void FarEditorSet::logStartupTime() const
+{
+  if (getErrorHandler() == nullptr) {
+    return;
+  }
+  double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTime).count();
+  wchar_t msg[256];
+  _snwprintf(msg, 256, L"startup: first coloured screen in %.1f ms (database %.1f ms, file type %.1f ms, parsing and drawing %.1f ms)",
+             total, baseLoadTime, firstEditorTime, total - baseLoadTime - firstEditorTime);
+  msg[255] = 0;
+  getErrorHandler()->warning(DString(msg));
+  profiler.writeReport(getErrorHandler());
+}
+
 FarEditor* FarEditorSet::addCurrentEditor()
 {
   EditorInfo ei;
@@ -894,30 +1666,372 @@ FarEditor* FarEditorSet::addCurrentEditor()
     return nullptr;
   }
 
-  FarEditor* editor = new FarEditor(&Info, parserFactory.get());
+  // schemes of the type are loaded here, at the first use
+  auto start = std::chrono::steady_clock::now();
+
+  std::wstring doc_key = getDocumentKey(CurrentEditor);
+  ParseDocument::FileState file_state;
+  bool file_state_valid = !doc_key.empty() && getFileState(CurrentEditor, doc_key, file_state);
+
+  // editors of the same unchanged file share the parse state,
+  // the text of the new editor is checked, the file can be changed outside of Far
+  std::shared_ptr<ParseDocument> doc;
+  auto it_doc = documents.find(doc_key);
+  if (it_doc != documents.end() && file_state_valid) {
+    doc = it_doc->second.lock();
+    if (doc && (doc->getGeneration() != 0 || doc->getParserFactory() != parserFactory.get() ||
+                doc->fileState.time == 0 || !doc->fileState.equals(file_state))) {
+      doc.reset();
+    }
+  }
+
+  // the file was closed recently - its parse state is still warm
+  if (!doc && file_state_valid) {
+    doc = takeClosedDocument(doc_key, file_state);
+    if (doc) {
+      documents[doc_key] = doc;
+    }
+  }
+
+  FarEditor* editor = new FarEditor(&Info, parserFactory.get(), &typeParams, doc);
   std::pair<intptr_t, FarEditor*> pair_editor(ei.EditorID, editor);
   farEditorInstances.emplace(pair_editor);
-  String* s = getCurrentFileName();
-  editor->chooseFileType(s);
-  delete s;
+  touchEditor(ei.EditorID);
+  // the shared document has the file type already
+  if (!doc) {
+    if (!doc_key.empty()) {
+      documents[doc_key] = editor->getDocument();
+    }
+    if (file_state_valid) {
+      editor->getDocument()->fileState = file_state;
+    }
+
+    String* s = getCurrentFileName();
+    {
+      // only the first choice after loading of the database is profiled
+      std::unique_ptr<PhaseProfiler::Phase> phase(profileFileType ? new PhaseProfiler::Phase(&profiler, L"chooseFileType") : nullptr);
+      profileFileType = false;
+      chooseEditorType(editor, s, doc_key);
+    }
+    delete s;
+  }
   editor->setTrueMod(TrueModOn);
   editor->setRegionMapper(regionMapper.get());
   editor->setDrawCross(drawCross, CrossStyle);
   editor->setDrawPairs(drawPairs);
   editor->setDrawSyntax(drawSyntax);
   editor->setOutlineStyle(oldOutline);
+  if (!firstColoured) {
+    firstEditorTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
 
   return editor;
 }
 
+std::wstring FarEditorSet::getDocumentKey(intptr_t editor_id)
+{
+  std::wstring key;
+  size_t size = Info.EditorControl(editor_id, ECTL_GETFILENAME, 0, nullptr);
+  if (size > 1) {
+    key.resize(size);
+    Info.EditorControl(editor_id, ECTL_GETFILENAME, size, &key[0]);
+    key.resize(size - 1);
+    // file names are case insensitive
+    CharLowerBuffW(&key[0], static_cast<DWORD>(key.length()));
+  }
+  return key;
+}
+
+bool FarEditorSet::getFileState(intptr_t editor_id, const std::wstring &file_name, ParseDocument::FileState &state)
+{
+  WIN32_FILE_ATTRIBUTE_DATA fad;
+  if (!GetFileAttributesExW(file_name.c_str(), GetFileExInfoStandard, &fad)) {
+    return false;
+  }
+  state.size = (static_cast<unsigned __int64>(fad.nFileSizeHigh) << 32) | fad.nFileSizeLow;
+  state.time = (static_cast<unsigned __int64>(fad.ftLastWriteTime.dwHighDateTime) << 32) | fad.ftLastWriteTime.dwLowDateTime;
+
+  EditorInfo ei;
+  ei.StructSize = sizeof(EditorInfo);
+  if (!Info.EditorControl(editor_id, ECTL_GETINFO, 0, &ei)) {
+    return false;
+  }
+
+  // FNV-1a of the line count and the head of the text,
+  // catches the changes that keep size and time of the file
+  const intptr_t hashLines = 64;
+  unsigned int hash = 2166136261u;
+  hash = (hash ^ static_cast<unsigned int>(ei.TotalLines)) * 16777619u;
+  for (intptr_t lno = 0; lno < ei.TotalLines && lno < hashLines; lno++) {
+    EditorGetString egs = {0};
+    egs.StructSize = sizeof(EditorGetString);
+    egs.StringNumber = lno;
+    if (!Info.EditorControl(editor_id, ECTL_GETSTRING, 0, &egs)) {
+      return false;
+    }
+    for (intptr_t i = 0; i < egs.StringLength; i++) {
+      hash = (hash ^ egs.StringText[i]) * 16777619u;
+    }
+    hash = (hash ^ L'\n') * 16777619u;
+  }
+  state.contentHash = hash;
+  return true;
+}
+
+std::shared_ptr<ParseDocument> FarEditorSet::takeClosedDocument(const std::wstring &doc_key, const ParseDocument::FileState &state)
+{
+  for (auto it = closedDocuments.begin(); it != closedDocuments.end(); ++it) {
+    if (it->key != doc_key) {
+      continue;
+    }
+    std::shared_ptr<ParseDocument> doc = it->document;
+    closedDocuments.erase(it);
+    if (!doc->fileState.equals(state)) {
+      return nullptr;
+    }
+    return doc;
+  }
+  return nullptr;
+}
+
+void FarEditorSet::keepClosedDocument(FarEditor* editor, const std::wstring &doc_key)
+{
+  std::shared_ptr<ParseDocument> doc = editor->getDocument();
+  // only the last editor of the unchanged file, parsed with the current database
+  if (doc_key.empty() || doc->viewCount() != 1 || doc->getGeneration() != 0 ||
+      doc->getParserFactory() != parserFactory.get() || doc->fileState.time == 0) {
+    return;
+  }
+  for (auto it = closedDocuments.begin(); it != closedDocuments.end(); ++it) {
+    if (it->key == doc_key) {
+      closedDocuments.erase(it);
+      break;
+    }
+  }
+  // a reopened file gets the closed document only after the check of the file
+  documents.erase(doc_key);
+  ClosedDocument closed = { doc_key, doc };
+  closedDocuments.push_front(closed);
+  if (closedDocuments.size() > cClosedDocumentsMax) {
+    closedDocuments.pop_back();
+  }
+}
+
+void FarEditorSet::chooseEditorType(FarEditor* editor, String* fname, const std::wstring &doc_key)
+{
+  if (doc_key.empty()) {
+    editor->chooseFileType(fname);
+    return;
+  }
+
+  unsigned int text_hash = editor->getTextStartHash();
+  const std::wstring* type_name = fileTypeCache.find(doc_key, text_hash);
+  FileType* ftype = nullptr;
+  if (type_name != nullptr) {
+    DString name(type_name->c_str());
+    ftype = hrcParser->getFileType(&name);
+  }
+  if (ftype != nullptr) {
+    editor->setFileType(ftype);
+  } else {
+    editor->chooseFileType(fname);
+    fileTypeCache.add(doc_key, text_hash, *editor->getFileType()->getName());
+  }
+}
+
+static void addStamp(unsigned __int64 &stamp, const void* data, size_t size)
+{
+  // FNV-1a
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    stamp = (stamp ^ bytes[i]) * 1099511628211ULL;
+  }
+}
+
+static void addFileStamp(unsigned __int64 &stamp, std::wstring path)
+{
+  if (path.size() > 1 && path.back() == L'\\') {
+    path.pop_back();
+  }
+  addStamp(stamp, path.c_str(), path.size() * sizeof(wchar_t));
+  WIN32_FILE_ATTRIBUTE_DATA fad;
+  if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) {
+    return;
+  }
+  addStamp(stamp, &fad.ftLastWriteTime, sizeof(fad.ftLastWriteTime));
+  addStamp(stamp, &fad.nFileSizeLow, sizeof(fad.nFileSizeLow));
+  if (!(fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+    return;
+  }
+
+  // all files of a folder location are loaded
+  WIN32_FIND_DATAW fd;
+  HANDLE find = FindFirstFileW((path + L"\\*").c_str(), &fd);
+  if (find == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  do {
+    if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+      addStamp(stamp, fd.cFileName, wcslen(fd.cFileName) * sizeof(wchar_t));
+      addStamp(stamp, &fd.ftLastWriteTime, sizeof(fd.ftLastWriteTime));
+      addStamp(stamp, &fd.nFileSizeLow, sizeof(fd.nFileSizeLow));
+    }
+  } while (FindNextFileW(find, &fd));
+  FindClose(find);
+}
+
+unsigned __int64 FarEditorSet::getBaseStamp() const
+{
+  unsigned __int64 stamp = 14695981039346656037ULL;
+  std::vector<std::wstring> sources;
+  if (sCatalogPathExp && sCatalogPathExp->length()) {
+    sources.push_back(sCatalogPathExp->getWChars());
+    CatalogLocations::read(sCatalogPathExp.get(), sources);
+  }
+  if (sUserHrcPathExp && sUserHrcPathExp->length()) {
+    sources.push_back(sUserHrcPathExp->getWChars());
+  }
+  // default values of the type parameters
+  StringBuffer profile(PluginPath);
+  profile.append(DString(FarProfileXml));
+  sources.push_back(profile.getWChars());
+
+  for (auto it = sources.begin(); it != sources.end(); ++it) {
+    addFileStamp(stamp, *it);
+  }
+
+  FileType* type;
+  for (int idx = 0; (type = hrcParser->enumerateFileTypes(idx)) != nullptr; idx++) {
+    addStamp(stamp, type->getName()->getWChars(), type->getName()->length() * sizeof(wchar_t));
+    addStamp(stamp, L"\n", sizeof(wchar_t));
+  }
+  return stamp;
+}
+
+void FarEditorSet::touchEditor(intptr_t editor_id)
+{
+  if (!recentEditors.empty() && recentEditors.front() == editor_id) {
+    return;
+  }
+  forgetEditor(editor_id);
+  recentEditors.push_front(editor_id);
+}
+
+void FarEditorSet::forgetEditor(intptr_t editor_id)
+{
+  for (auto it = recentEditors.begin(); it != recentEditors.end(); ++it) {
+    if (*it == editor_id) {
+      recentEditors.erase(it);
+      break;
+    }
+  }
+}
+
+size_t FarEditorSet::getMemoryUsage()
+{
+  size_t usage = 0;
+  for (auto fe = farEditorInstances.begin(); fe != farEditorInstances.end(); ++fe) {
+    ParseDocument* doc = fe->second->getDocument().get();
+    // shared documents are counted at the first editor
+    bool counted = false;
+    for (auto prev = farEditorInstances.begin(); doc->viewCount() > 1 && prev != fe && !counted; ++prev) {
+      counted = prev->second->getDocument().get() == doc;
+    }
+    if (!counted) {
+      usage += doc->getMemoryUsage();
+    }
+  }
+  for (auto it = closedDocuments.begin(); it != closedDocuments.end(); ++it) {
+    usage += it->document->getMemoryUsage();
+  }
+  return usage;
+}
+
+void FarEditorSet::applyMemoryBudget(FarEditor* current)
+{
+  if (memoryBudget <= 0) {
+    return;
+  }
+  size_t budget = static_cast<size_t>(memoryBudget) << 20;
+  size_t usage = getMemoryUsage();
+  if (usage <= budget) {
+    return;
+  }
+
+  while (usage > budget && !closedDocuments.empty()) {
+    usage -= closedDocuments.back().document->getMemoryUsage();
+    closedDocuments.pop_back();
+    evictionCount++;
+  }
+
+  for (auto it = recentEditors.rbegin(); usage > budget && it != recentEditors.rend(); ++it) {
+    auto it_editor = farEditorInstances.find(*it);
+    if (it_editor == farEditorInstances.end() || it_editor->second == current) {
+      continue;
+    }
+    FarEditor* editor = it_editor->second;
+    // the shared state is still used by the other editors of the file
+    if (editor->getDocument()->viewCount() != 1) {
+      continue;
+    }
+    size_t editor_usage = editor->getDocument()->getMemoryUsage();
+    editor->dropParseState();
+    usage -= editor_usage - editor->getDocument()->getMemoryUsage();
+    evictionCount++;
+
+    std::wstring doc_key = getDocumentKey(it_editor->first);
+    if (!doc_key.empty() && editor->getDocument()->getGeneration() == 0) {
+      documents[doc_key] = editor->getDocument();
+    }
+  }
+}
+
+void FarEditorSet::getMemoryReport(StringBuffer &report)
+{
+  wchar_t line[128];
+  for (auto it = recentEditors.begin(); it != recentEditors.end(); ++it) {
+    auto it_editor = farEditorInstances.find(*it);
+    if (it_editor == farEditorInstances.end()) {
+      continue;
+    }
+    std::shared_ptr<ParseDocument> doc = it_editor->second->getDocument();
+    _snwprintf(line, 128, L"%10Iu KB  %Iu  ", doc->getMemoryUsage() >> 10, doc->viewCount());
+    line[127] = 0;
+    report.append(DString(line));
+    String* fname = getEditorFileName(it_editor->first);
+    if (fname != nullptr) {
+      report.append(fname);
+      delete fname;
+    }
+    report.append(DString("\n"));
+  }
+
+  size_t closed_usage = 0;
+  for (auto it = closedDocuments.begin(); it != closedDocuments.end(); ++it) {
+    closed_usage += it->document->getMemoryUsage();
+  }
+  _snwprintf(line, 128, L"%10Iu KB  closed files: %Iu\n", closed_usage >> 10, closedDocuments.size());
+  line[127] = 0;
+  report.append(DString(line));
+
+  _snwprintf(line, 128, L"%10Iu KB  total, budget %d MB, freed %Iu\n", getMemoryUsage() >> 10, memoryBudget, evictionCount);
+  line[127] = 0;
+  report.append(DString(line));
+}
+
 String* FarEditorSet::getCurrentFileName()
+{
+  return getEditorFileName(CurrentEditor);
+}
+
+String* FarEditorSet::getEditorFileName(intptr_t editor_id)
 {
   LPWSTR FileName = nullptr;
-  size_t FileNameSize = Info.EditorControl(CurrentEditor, ECTL_GETFILENAME, 0, nullptr);
+  size_t FileNameSize = Info.EditorControl(editor_id, ECTL_GETFILENAME, 0, nullptr);
 
   if (FileNameSize) {
     FileName = new wchar_t[FileNameSize];
-    Info.EditorControl(CurrentEditor, ECTL_GETFILENAME, FileNameSize, FileName);
+    Info.EditorControl(editor_id, ECTL_GETFILENAME, FileNameSize, FileName);
   }
 
   DString fnpath(FileName);
@@ -953,13 +2067,16 @@ void FarEditorSet::disableColorer()
 {
   rEnabled = false;
   if (!(err_status & ERR_FARSETTINGS_ERROR)) {
-    SettingsControl ColorerSettings;
-    ColorerSettings.Set(0, cRegEnabled, rEnabled);
+    settingsCache.Set(0, cRegEnabled, rEnabled);
   }
 
+  closedDocuments.clear();
   dropCurrentEditor(true);
 
   regionMapper.release();
+  typeParams.reset(nullptr);
+  typeCatalog.reset(nullptr);
+  typeMenu.reset();
   parserFactory.release();
   SaveSettings();
 }
@@ -994,6 +2111,7 @@ void FarEditorSet::dropCurrentEditor(bool clean)
     }
     delete it_editor->second;
     farEditorInstances.erase(ei.EditorID);
+    forgetEditor(ei.EditorID);
     Info.EditorControl(CurrentEditor, ECTL_REDRAW, 0, nullptr);
   }
 }
@@ -1004,12 +2122,16 @@ void FarEditorSet::dropAllEditors(bool clean)
     //      ,  
     dropCurrentEditor(clean);
   }
+  for (auto fe = farEditorInstances.begin(); fe != farEditorInstances.end(); ++fe) {
+    delete fe->second;
+  }
   farEditorInstances.clear();
+  recentEditors.clear();
 }
 
 void FarEditorSet::ReadSettings()
 {
-  SettingsControl ColorerSettings;
+  SettingsCache &ColorerSettings = settingsCache;
   const wchar_t* hrdName = ColorerSettings.Get(0, cRegHrdName, cHrdNameDefault);
   const wchar_t* hrdNameTm = ColorerSettings.Get(0, cRegHrdNameTm, cHrdNameTmDefault);
   const wchar_t* catalogPath = ColorerSettings.Get(0, cRegCatalog, cCatalogDefault);
@@ -1040,18 +2162,35 @@ void FarEditorSet::ReadSettings()
   oldOutline = ColorerSettings.Get(0, cRegOldOutLine, cOldOutLineDefault);
   TrueModOn = ColorerSettings.Get(0, cRegTrueMod, cTrueMod);
   ChangeBgEditor = ColorerSettings.Get(0, cRegChangeBgEditor, cChangeBgEditor);
+  memoryBudget = ColorerSettings.Get(0, cRegMemoryBudget, cMemoryBudgetDefault);
+}
+
+void FarEditorSet::flushSettings()
+{
+  if (err_status & ERR_FARSETTINGS_ERROR) {
+    return;
+  }
+  try {
+    settingsCache.flush();
+  } catch (Exception &e) {
+    if (getErrorHandler() != nullptr) {
+      getErrorHandler()->error(*e.getMessage());
+    }
+  }
 }
 
 void FarEditorSet::setLogPath(const wchar_t* log_path)
 {
   if (sLogPath && sLogPath->compareToIgnoreCase(DString(log_path)) != 0) {
-    error_handler.release();
+    // parser factories keep their copies of the old handler
+    sync_error_handler.reset();
   }
   sLogPath.reset(new SString(DString(log_path)));
   sLogPathExp.reset(PathToFullS(log_path, false));
-  if (error_handler == nullptr && sLogPathExp != nullptr) {
+  if (sync_error_handler == nullptr && sLogPathExp != nullptr) {
     try {
-      error_handler.reset(new FileErrorHandler(sLogPathExp.get(), Encodings::ENC_UTF8, false));
+      std::unique_ptr<colorer::ErrorHandler> file_handler(new FileErrorHandler(sLogPathExp.get(), Encodings::ENC_UTF8, false));
+      sync_error_handler.reset(new SyncErrorHandler(std::move(file_handler)));
     } catch (Exception &e) {
       showExceptionMessage(e.getMessage()->getWChars());
     }
@@ -1059,9 +2198,9 @@ void FarEditorSet::setLogPath(const wchar_t* log_path)
 
 }
 
-void FarEditorSet::SaveSettings() const
+void FarEditorSet::SaveSettings()
 {
-  SettingsControl ColorerSettings;
+  SettingsCache &ColorerSettings = settingsCache;
   ColorerSettings.Set(0, cRegEnabled, rEnabled);
   ColorerSettings.Set(0, cRegHrdName, sHrdName->getWChars());
   ColorerSettings.Set(0, cRegHrdNameTm, sHrdNameTm->getWChars());
@@ -1076,6 +2215,9 @@ void FarEditorSet::SaveSettings() const
   ColorerSettings.Set(0, cRegUserHrdPath, sUserHrdPath->getWChars());
   ColorerSettings.Set(0, cRegUserHrcPath, sUserHrcPath->getWChars());
   ColorerSettings.Set(0, cRegLogPath, sLogPath->getWChars());
+  ColorerSettings.Set(0, cRegMemoryBudget, memoryBudget);
+  // the user's choice is written at once, Far can be closed without idle time
+  flushSettings();
 }
 
 bool FarEditorSet::SetBgEditor() const
@@ -1109,48 +2251,27 @@ bool FarEditorSet::SetBgEditor() const
 void FarEditorSet::LoadUserHrd(const String* filename, ParserFactory* pf)
 {
   if (filename && filename->length()) {
-    xercesc::XercesDOMParser xml_parser;
-    XmlParserErrorHandler err_handler(error_handler.get());
-    xml_parser.setErrorHandler(&err_handler);
-    xml_parser.setLoadExternalDTD(false);
-    xml_parser.setSkipDTDValidation(true);
-    XmlInputSource* config = XmlInputSource::newInstance(filename->getWChars(), static_cast<XMLCh*>(nullptr));
-    xml_parser.parse(*config->getInputSource());
+    std::unique_ptr<xercesc::SAX2XMLReader> reader(xercesc::XMLReaderFactory::createXMLReader());
+    reader->setFeature(xercesc::XMLUni::fgXercesLoadExternalDTD, false);
+    reader->setFeature(xercesc::XMLUni::fgXercesSkipDTDValidation, true);
+    HrdSetsReader hrd_reader(pf);
+    XmlParserErrorHandler err_handler(pf->getErrorHandler());
+    reader->setContentHandler(&hrd_reader);
+    reader->setErrorHandler(&err_handler);
+    std::unique_ptr<XmlInputSource> config(XmlInputSource::newInstance(filename->getWChars(), static_cast<XMLCh*>(nullptr)));
+    reader->parse(*config->getInputSource());
     if (err_handler.getSawErrors()) {
       throw ParserFactoryException(StringBuffer("Error reading ") + DString(filename));
     }
-    xercesc::DOMDocument* catalog = xml_parser.getDocument();
-    xercesc::DOMElement* elem = catalog->getDocumentElement();
-    const XMLCh* tagHrdSets = L"hrd-sets";
-    const XMLCh* tagHrd = L"hrd";
-    if (elem == nullptr || !xercesc::XMLString::equals(elem->getNodeName(), tagHrdSets)) {
+    if (!hrd_reader.isRootFound()) {
       throw Exception(DString("main '<hrd-sets>' block not found"));
     }
-    for (xercesc::DOMNode* node = elem->getFirstChild(); node != nullptr; node = node->getNextSibling()) {
-      if (node->getNodeType() == xercesc::DOMNode::ELEMENT_NODE) {
-        xercesc::DOMElement* subelem = static_cast<xercesc::DOMElement*>(node);
-        if (xercesc::XMLString::equals(subelem->getNodeName(), tagHrd)) {
-          pf->parseHRDSetsChild(subelem);
-        }
-      }
-    }
-    delete config;
   }
 }
 
 void FarEditorSet::LoadUserHrc(const String* filename, ParserFactory* pf)
 {
-  if (filename && filename->length()) {
-    HRCParser* hr = pf->getHRCParser();
-    XmlInputSource* dfis = XmlInputSource::newInstance(filename->getWChars(), static_cast<XMLCh*>(nullptr));
-    try {
-      hr->loadSource(dfis);
-      delete dfis;
-    } catch (Exception &e) {
-      delete dfis;
-      throw Exception(e);
-    }
-  }
+  loadUserHrc(pf->getHRCParser(), filename);
 }
 
 const String* FarEditorSet::getParamDefValue(FileTypeImpl* type, SString param) const
@@ -1166,49 +2287,6 @@ const String* FarEditorSet::getParamDefValue(FileTypeImpl* type, SString param)
   return p;
 }
 
-FarList* FarEditorSet::buildHrcList() const
-{
-  size_t num = getCountFileTypeAndGroup();
-  const String* group = nullptr;
-  FileType* type = nullptr;
-
-  FarListItem* hrcList = new FarListItem[num];
-  memset(hrcList, 0, sizeof(FarListItem) * (num));
-
-  for (int idx = 0, i = 0;; idx++, i++) {
-    type = hrcParser->enumerateFileTypes(idx);
-
-    if (type == nullptr) {
-      break;
-    }
-
-    if (group != nullptr && !group->equals(type->getGroup())) {
-      hrcList[i].Flags = LIF_SEPARATOR;
-      i++;
-    }
-
-    group = type->getGroup();
-
-    const wchar_t* groupChars = nullptr;
-
-    if (group != nullptr) {
-      groupChars = group->getWChars();
-    } else {
-      groupChars = L"<no group>";
-    }
-
-    hrcList[i].Text = new wchar_t[255];
-    _snwprintf(const_cast<wchar_t*>(hrcList[i].Text), 255, L"%s: %s", groupChars, type->getDescription()->getWChars());
-  }
-
-  hrcList[0].Flags = LIF_SELECTED;
-  FarList* ListItems = new FarList;
-  ListItems->Items = hrcList;
-  ListItems->ItemsNumber = num;
-  ListItems->StructSize = sizeof(FarList);
-  return ListItems;
-}
-
 FarList* FarEditorSet::buildParamsList(FileTypeImpl* type) const
 {
   //max count params
@@ -1424,10 +2502,10 @@ void FarEditorSet::setCustomListValueToCombobox(FileTypeImpl* type, HANDLE hDlg,
   delete lcross;
 }
 
-FileTypeImpl* FarEditorSet::getCurrentTypeInDialog(HANDLE hDlg) const
+FileTypeImpl* FarEditorSet::getCurrentTypeInDialog(HANDLE hDlg)
 {
   int k = static_cast<int>(Info.SendDlgMessage(hDlg, DM_LISTGETCURPOS, IDX_CH_SCHEMAS, nullptr));
-  return getFileTypeByIndex(k);
+  return static_cast<FileTypeImpl*>(typeCatalog.getListType(k));
 }
 
 void  FarEditorSet::OnChangeHrc(HANDLE hDlg)
@@ -1465,10 +2543,14 @@ void FarEditorSet::SaveChangedValueParam(HANDLE hDlg)
         static_cast<FileTypeImpl*>(type)->addParam(&p);
       }
       type->setParamValue(p, &v);
+      typeParams.invalidate(type);
+      typeMenu.reset();
     }
   } else { //  
     if (!v.equals(value)) { //changed
       type->setParamValue(p, &v);
+      typeParams.invalidate(type);
+      typeMenu.reset();
     }
   }
 
@@ -1521,8 +2603,9 @@ void  FarEditorSet::OnChangeParam(HANDLE hDlg, intptr_t idx)
 void FarEditorSet::OnSaveHrcParams(HANDLE hDlg)
 {
   SaveChangedValueParam(hDlg);
-  FarHrcSettings p(parserFactory.get());
+  FarHrcSettings p(parserFactory.get(), &settingsCache);
   p.writeUserProfile();
+  flushSettings();
 }
 
 INT_PTR WINAPI SettingHrcDialogProc(HANDLE hDlg, intptr_t Msg, intptr_t Param1, void* Param2)
@@ -1590,8 +2673,7 @@ void FarEditorSet::configureHrc()
 
   fdi[IDX_CH_BOX].Data = GetMsg(mUserHrcSettingDialog);
   fdi[IDX_CH_CAPTIONLIST].Data = GetMsg(mListSyntax);
-  FarList* l = buildHrcList();
-  fdi[IDX_CH_SCHEMAS].ListItems = l;
+  fdi[IDX_CH_SCHEMAS].ListItems = typeCatalog.getList();
   fdi[IDX_CH_SCHEMAS].Flags = DIF_LISTWRAPMODE | DIF_DROPDOWNLIST;
   fdi[IDX_CH_OK].Data = GetMsg(mOk);
   fdi[IDX_CH_CANCEL].Data = GetMsg(mCancel);
@@ -1605,13 +2687,6 @@ void FarEditorSet::configureHrc()
   dialogFirstFocus = true;
   HANDLE hDlg = Info.DialogInit(&MainGuid, &HrcPluginConfig, -1, -1, 59, 23, L"confighrc", fdi, ARRAY_SIZE(fdi), 0, 0, SettingHrcDialogProc, this);
   Info.DialogRun(hDlg);
-
-  for (size_t idx = 0; idx < l->ItemsNumber; idx++) {
-    delete[] l->Items[idx].Text;
-  }
-  delete[] l->Items;
-  delete l;
-
   Info.DialogFree(hDlg);
 }
 
@@ -1,14 +1,25 @@
 #ifndef _FAREDITORSET_H_
 #define _FAREDITORSET_H_
 
+#include <chrono>
+#include <list>
+#include <string>
+#include <thread>
 #include <colorer/handlers/FileErrorHandler.h>
 #include <colorer/handlers/LineRegionsSupport.h>
-#include <colorer/viewer/TextConsoleViewer.h>
 
 #include "pcolorer.h"
 #include "FarEditor.h"
 #include "FarHrcSettings.h"
+#include "SettingsCache.h"
+#include "TypeCatalog.h"
 #include "ChooseTypeMenu.h"
+#include "PhaseProfiler.h"
+#include "SyncErrorHandler.h"
+#include "FileTypeCache.h"
+#include "MappedTextViewer.h"
+
+class TypeLoader;
 
 //registry keys
 const wchar_t cRegEnabled[]        = L"Enabled";
@@ -25,6 +36,7 @@ const wchar_t cRegChangeBgEditor[] = L"ChangeBgEditor";
 const wchar_t cRegUserHrdPath[]    = L"UserHrdPath";
 const wchar_t cRegUserHrcPath[]    = L"UserHrcPath";
 const wchar_t cRegLogPath[]        = L"LogPath";
+const wchar_t cRegMemoryBudget[]   = L"MemoryBudget";
 
 //values of registry keys by default
 const bool cEnabledDefault          = true;
@@ -41,6 +53,13 @@ const bool cChangeBgEditor          = false;
 const wchar_t cUserHrdPathDefault[] = L"";
 const wchar_t cUserHrcPathDefault[] = L"";
 const wchar_t cLogPathDefault[] = L"";
+// megabytes of parse states of all editors, 0 - no limit
+const int cMemoryBudgetDefault      = 0;
+
+// parse states of the closed files kept for reopening
+const size_t cClosedDocumentsMax = 8;
+// matches shown in the menu of the region grep
+const size_t cGrepResultsMax = 10000;
 
 const DString DConsole   = DString("console");
 const DString DRgb       = DString("rgb");
@@ -50,7 +69,7 @@ const DString DAutodetect = DString("autodetect");
 enum {
   IDX_BOX, IDX_ENABLED, IDX_CROSS, IDX_CROSS_TEXT, IDX_CROSS_STYLE, IDX_PAIRS, IDX_SYNTAX, IDX_OLDOUTLINE, IDX_CHANGE_BG,
   IDX_HRD, IDX_HRD_SELECT, IDX_CATALOG, IDX_CATALOG_EDIT, IDX_USERHRC, IDX_USERHRC_EDIT,
-  IDX_USERHRD, IDX_USERHRD_EDIT, IDX_LOG, IDX_LOG_EDIT, IDX_TM_BOX, IDX_TRUEMOD, IDX_HRD_TM,
+  IDX_USERHRD, IDX_USERHRD_EDIT, IDX_LOG, IDX_LOG_EDIT, IDX_MEMORY, IDX_MEMORY_EDIT, IDX_TM_BOX, IDX_TRUEMOD, IDX_HRD_TM,
   IDX_HRD_SELECT_TM, IDX_TM_BOX_OFF, IDX_RELOAD_ALL, IDX_HRC_SETTING, IDX_OK, IDX_CANCEL
 };
 
@@ -87,6 +106,24 @@ public:
   void configure(bool fromEditor);
   /** Views current file with internal viewer */
   void viewFile(const String &path);
+  /** Colorizes files to HTML, ANSI text or token streams.
+      @param args format (html, ansi or tokens), output folder and file masks
+  */
+  void colorizeFiles(const wchar_t* args);
+  /** Searches files in folders and subfolders for the regular expression in the given regions
+      and shows the matches in the menu.
+      @param args options, expression and file masks
+  */
+  void grepFiles(const wchar_t* args);
+  /** Writes regions of the current editor to the token stream file.
+      @return false if there is no editor or the file can't be written
+  */
+  bool exportTokens(const wchar_t* path);
+  /** Moves the cursor of the current editor to the next or previous occurrence of the region.
+      @param regionName name of the region, it is asked if nullptr
+      @return false if the region is not found
+  */
+  bool findRegion(const wchar_t* regionName, bool forward);
 
   /** Dispatch editor event in the opened editor */
   int  editorEvent(const struct ProcessEditorEventInfo* pInfo);
@@ -105,6 +142,8 @@ public:
   */
   enum HRC_MODE {HRCM_CONSOLE, HRCM_RGB, HRCM_BOTH};
   bool TestLoadBase(const wchar_t* catalogPath, const wchar_t* userHrdPath, const wchar_t* userHrcPath, const int full, const HRC_MODE hrc_mode);
+  /** Shows the total load time and the slowest file types, writes all load times to the log */
+  void showLoadTimes(TypeLoader &loader);
   
   SString* GetCatalogPath() const
   {
@@ -140,6 +179,15 @@ public:
   void OnChangeParam(HANDLE hDlg, intptr_t idx);
   void OnSaveHrcParams(HANDLE hDlg);
 
+  /** Moves editors to the database built by the background reload.
+      Called in the main thread on synchro event.
+  */
+  void applyReloadedBase();
+  /** Time and memory usage of the phases of the last database loading */
+  void getProfileReport(StringBuffer &report) const;
+  /** Memory usage of parse states, one line per editor and the total line */
+  void getMemoryReport(StringBuffer &report);
+
   void showExceptionMessage(const wchar_t* message);
   void setLogPath(const wchar_t* log_path);
 
@@ -153,40 +201,98 @@ private:
   colorer::ErrorHandler* getErrorHandler() const;
   /** add current active editor and return him. */
   FarEditor* addCurrentEditor();
+  /** Writes time to the first coloured screen to the log */
+  void logStartupTime() const;
   /** Returns currently active editor. */
   FarEditor* getCurrentEditor();
   /**
   * Reloads HRC database.
-  * Drops all currently opened editors and their
-  * internal structures. Prepares to work with newly
-  * loaded database. Read settings from registry
+  * Read settings from registry. The first load is done here,
+  * drops current editor and prepares to work with newly
+  * loaded database. If the database is already loaded,
+  * the new one is built in the background thread, and the
+  * opened editors keep working with the old one until
+  * applyReloadedBase. A call during the background reload
+  * starts one more reload after it.
   */
   void ReloadBase();
 
+  /** HRC database with the parameters of its loading */
+  struct HrcBase {
+    std::unique_ptr<SString> catalogPath;
+    std::unique_ptr<SString> userHrdPath;
+    std::unique_ptr<SString> userHrcPath;
+    std::unique_ptr<SString> hrdName;
+    bool trueMod;
+    /** log of the loading, kept while parserFactory uses it */
+    std::shared_ptr<SyncErrorHandler> errorHandler;
+    /** file types of the opened editors, loaded before the switch */
+    std::vector<std::unique_ptr<SString>> preloadTypes;
+
+    std::unique_ptr<ParserFactory> parserFactory;
+    std::unique_ptr<RegionMapper> regionMapper;
+    std::unique_ptr<SString> error;
+    PhaseProfiler profiler;
+  };
+  /** Starts the background reload of HRC database */
+  void startReloadBase();
+  /** Background thread of the reload */
+  void buildBase(HrcBase* base);
+
   /** Shows dialog of file type selection */
   void chooseType();
   /** FAR localized messages */
   const wchar_t* GetMsg(int msg);
   /** Applies the current settings for editors*/
   void ApplySettingsToEditors();
-  /** writes settings in the registry*/
-  void SaveSettings() const;
+  /** writes settings in the registry at once*/
+  void SaveSettings();
+  /** Writes the changed settings, errors go to the log */
+  void flushSettings();
 
   /** Kills all currently opened editors*/
   void dropAllEditors(bool clean);
   /** kill the current editor*/
   void dropCurrentEditor(bool clean);
 
-  size_t getCountFileTypeAndGroup() const;
-  FileTypeImpl* getFileTypeByIndex(int idx) const;
-  void FillTypeMenu(ChooseTypeMenu* Menu, FileType* CurFileType) const;
+  void FillTypeMenu(ChooseTypeMenu* Menu);
   String* getCurrentFileName();
+  String* getEditorFileName(intptr_t editor_id);
+  /** Key of the editor in documents - lowercased full file name */
+  std::wstring getDocumentKey(intptr_t editor_id);
+  /** Size and time of the file, hash of the editor text */
+  bool getFileState(intptr_t editor_id, const std::wstring &file_name, ParseDocument::FileState &state);
+  /** Takes the parse state of the closed file, if the file is the same */
+  std::shared_ptr<ParseDocument> takeClosedDocument(const std::wstring &doc_key, const ParseDocument::FileState &state);
+  /** Keeps the parse state of the closing editor */
+  void keepClosedDocument(FarEditor* editor, const std::wstring &doc_key);
+
+  /** Chooses file type of the new editor, the choice is remembered in fileTypeCache */
+  void chooseEditorType(FarEditor* editor, String* fname, const std::wstring &doc_key);
+  /** Hash of the file types and the source files of the loaded database:
+      catalog, its hrc locations, user hrc and hrcsettings.xml */
+  unsigned __int64 getBaseStamp() const;
+
+  /** Moves the editor to the front of recentEditors */
+  void touchEditor(intptr_t editor_id);
+  void forgetEditor(intptr_t editor_id);
+  /** Total size of the parse states of editors and closed files */
+  size_t getMemoryUsage();
+  /** Frees parse states of closed files, then of the least recently used
+      editors, until the usage fits in memoryBudget. The current editor is kept.
+  */
+  void applyMemoryBudget(FarEditor* current);
 
   // FarList for dialog objects
-  FarList* buildHrcList() const;
   FarList* buildParamsList(FileTypeImpl* type) const;
   // filetype "default"
   FileTypeImpl* defaultType;
+  /** plugin parameters of the types of the current database */
+  TypeParams typeParams;
+  /** types of the current database in the order of menus */
+  TypeCatalog typeCatalog;
+  /** type menu, kept until the database or the type parameters change */
+  std::unique_ptr<ChooseTypeMenu> typeMenu;
   //change combobox type
   void ChangeParamValueListType(HANDLE hDlg, bool dropdownlist);
   //set list of values to combobox
@@ -196,17 +302,42 @@ private:
   void setTFListValueToCombobox(FileTypeImpl* type, HANDLE hDlg, DString param);
   void setCustomListValueToCombobox(FileTypeImpl* type, HANDLE hDlg, DString param);
 
-  FileTypeImpl* getCurrentTypeInDialog(HANDLE hDlg) const;
+  FileTypeImpl* getCurrentTypeInDialog(HANDLE hDlg);
 
   const String* getParamDefValue(FileTypeImpl* type, SString param) const;
 
   void SaveChangedValueParam(HANDLE hDlg);
 
   std::unordered_map<intptr_t, FarEditor*> farEditorInstances;
+  /** ids of the editors, the most recently used first */
+  std::list<intptr_t> recentEditors;
+  /** number of parse states freed by memory budget */
+  size_t evictionCount;
+  /** parse states of the opened files, shared by editors of the same file */
+  std::unordered_map<std::wstring, std::weak_ptr<ParseDocument>> documents;
+  /** log of parserFactory, it is destroyed after the factory */
+  std::shared_ptr<SyncErrorHandler> factory_error_handler;
   std::unique_ptr<ParserFactory> parserFactory;
   std::unique_ptr<RegionMapper> regionMapper;
   HRCParser* hrcParser;
 
+  struct ClosedDocument {
+    std::wstring key;
+    std::shared_ptr<ParseDocument> document;
+  };
+  /** parse states of the closed files, the most recent first.
+      Declared after parserFactory, so they are destroyed before it.
+  */
+  std::list<ClosedDocument> closedDocuments;
+  FileTypeCache fileTypeCache;
+  /** plugin settings, read once; explicit saves are written at once, the rest on idle and exit */
+  SettingsCache settingsCache;
+
+  std::thread reloadThread;
+  std::unique_ptr<HrcBase> reloadedBase;
+  /** ReloadBase was called during the background reload */
+  bool reloadAgain;
+
   /**current value*/
   DString hrdClass;
   DString hrdName;
@@ -220,6 +351,7 @@ private:
   bool oldOutline;
   bool TrueModOn;
   bool ChangeBgEditor;
+  int memoryBudget; // megabytes
   std::unique_ptr<SString> sHrdName;
   std::unique_ptr<SString> sHrdNameTm;
   std::unique_ptr<SString> sCatalogPath;
@@ -236,9 +368,21 @@ private:
   int CurrentMenuItem;
 
   unsigned int err_status;
-  std::unique_ptr<colorer::ErrorHandler> error_handler;
+  /** log file of the current log path, shared by the main and the reload threads.
+      Each parser factory holds a copy, so the handler lives until the last one is destroyed.
+  */
+  std::shared_ptr<SyncErrorHandler> sync_error_handler;
 
   bool in_construct;
+
+  /** startup metrics */
+  std::chrono::steady_clock::time_point startupTime;
+  double baseLoadTime;
+  double firstEditorTime;
+  bool firstColoured;
+  PhaseProfiler profiler;
+  /** the next choice of file type is profiled */
+  bool profileFileType;
 };
 
 #endif
@@ -1,95 +1,150 @@
 #include "FarHrcSettings.h"
-#include "SettingsControl.h"
+#include "SettingsCache.h"
+#include "HrcSettingsCache.h"
 #include <xml/XmlParserErrorHandler.h>
 #include <colorer/ParserFactoryException.h>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+
+/** Streaming reader of hrcsettings.xml, the parameters are set as the elements are parsed.
+    The file type is found once for each prototype.
+*/
+class HrcSettingsHandler : public xercesc::DefaultHandler
+{
+public:
+  HrcSettingsHandler(FarHrcSettings* settings_, bool userValue_, HrcSettingsCache* cache_) :
+    settings(settings_), userValue(userValue_), cache(cache_), depth(0), rootFound(false), type(nullptr)
+  {
+  }
+
+  void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname,
+                    const xercesc::Attributes &attrs)
+  {
+    depth++;
+    if (depth == 1) {
+      rootFound = xercesc::XMLString::equals(qname, L"hrc-settings");
+    } else if (!rootFound) {
+      return;
+    } else if (depth == 2 && xercesc::XMLString::equals(qname, L"prototype")) {
+      const XMLCh* name = attrs.getValue(L"name");
+      typeName.reset(name != nullptr ? new SString(DString(name)) : nullptr);
+      type = typeName ? static_cast<FileTypeImpl*>(settings->parserFactory->getHRCParser()->getFileType(typeName.get())) : nullptr;
+    } else if (depth == 3 && typeName && xercesc::XMLString::equals(qname, L"param")) {
+      const XMLCh* name = attrs.getValue(L"name");
+      const XMLCh* value = attrs.getValue(L"value");
+      const XMLCh* descr = attrs.getValue(L"description");
+      if (name == nullptr || value == nullptr || *name == '\0' || *value == '\0') {
+        return;
+      }
+
+      DString dname(name);
+      DString dvalue(value);
+      std::unique_ptr<DString> description;
+      if (descr != nullptr) {
+        description.reset(new DString(descr));
+      }
+      settings->setPrototypeParam(type, dname, dvalue, description.get(), userValue);
+      if (cache) {
+        cache->add(*typeName, dname, dvalue, description.get());
+      }
+    }
+  }
+
+  void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname)
+  {
+    if (depth == 2) {
+      typeName.reset();
+      type = nullptr;
+    }
+    depth--;
+  }
+
+  bool isRootFound() const
+  {
+    return rootFound;
+  }
+
+private:
+  FarHrcSettings* settings;
+  bool userValue;
+  HrcSettingsCache* cache;
+  int depth;
+  bool rootFound;
+  std::unique_ptr<SString> typeName;
+  FileTypeImpl* type;
+};
 
 void FarHrcSettings::readProfile()
 {
   StringBuffer* path = new StringBuffer(PluginPath);
   path->append(DString(FarProfileXml));
-  readXML(path, false);
+
+  // xml is parsed only if the cache is out of date
+  HrcSettingsCache cache(path);
+  if (cache.load()) {
+    HrcSettingsCache::Record rec;
+    // records of a type go one after another, the type is found once
+    FileTypeImpl* type = nullptr;
+    std::unique_ptr<SString> type_name;
+    while (cache.next(rec)) {
+      DString rec_type(rec.type, 0, rec.typeLength);
+      if (!type_name || !type_name->equals(&rec_type)) {
+        type_name.reset(new SString(rec_type));
+        type = static_cast<FileTypeImpl*>(parserFactory->getHRCParser()->getFileType(type_name.get()));
+      }
+      std::unique_ptr<DString> descr;
+      if (rec.description) {
+        descr.reset(new DString(rec.description, 0, rec.descriptionLength));
+      }
+      setPrototypeParam(type, DString(rec.name, 0, rec.nameLength), DString(rec.value, 0, rec.valueLength), descr.get(), false);
+    }
+  } else {
+    readXML(path, false, &cache);
+    cache.save();
+  }
 
   delete path;
 }
 
-void FarHrcSettings::readXML(String* file, bool userValue)
+void FarHrcSettings::readXML(String* file, bool userValue, HrcSettingsCache* cache)
 {
-  xercesc::XercesDOMParser xml_parser;
+  std::unique_ptr<xercesc::SAX2XMLReader> reader(xercesc::XMLReaderFactory::createXMLReader());
+  reader->setFeature(xercesc::XMLUni::fgXercesLoadExternalDTD, false);
+  reader->setFeature(xercesc::XMLUni::fgXercesSkipDTDValidation, true);
+  HrcSettingsHandler handler(this, userValue, cache);
   XmlParserErrorHandler error_handler(nullptr);
-  xml_parser.setErrorHandler(&error_handler);
-  xml_parser.setLoadExternalDTD(false);
-  xml_parser.setSkipDTDValidation(true);
-  XmlInputSource* config = XmlInputSource::newInstance(file->getWChars(), static_cast<XMLCh*>(nullptr));
-  xml_parser.parse(*config->getInputSource());
+  reader->setContentHandler(&handler);
+  reader->setErrorHandler(&error_handler);
+
+  std::unique_ptr<XmlInputSource> config(XmlInputSource::newInstance(file->getWChars(), static_cast<XMLCh*>(nullptr)));
+  reader->parse(*config->getInputSource());
   if (error_handler.getSawErrors()) {
-    delete config;
     throw ParserFactoryException(DString("Error reading hrcsettings.xml."));
   }
-  xercesc::DOMDocument* catalog = xml_parser.getDocument();
-  xercesc::DOMElement* elem = catalog->getDocumentElement();
-
-  const XMLCh* tagPrototype = L"prototype";
-  const XMLCh* tagHrcSettings = L"hrc-settings";
-
-  if (elem == nullptr || !xercesc::XMLString::equals(elem->getNodeName(), tagHrcSettings)) {
-    delete config;
+  if (!handler.isRootFound()) {
     throw FarHrcSettingsException(DString("main '<hrc-settings>' block not found"));
   }
-  for (xercesc::DOMNode* node = elem->getFirstChild(); node != nullptr; node = node->getNextSibling()) {
-    if (node->getNodeType() == xercesc::DOMNode::ELEMENT_NODE) {
-      xercesc::DOMElement* subelem = static_cast<xercesc::DOMElement*>(node);
-      if (xercesc::XMLString::equals(subelem->getNodeName(), tagPrototype)) {
-        UpdatePrototype(subelem, userValue);
-      }
-    }
-  }
-  delete config;
 }
 
-void FarHrcSettings::UpdatePrototype(xercesc::DOMElement* elem, bool userValue)
+void FarHrcSettings::setPrototypeParam(FileTypeImpl* type, const String &name, const String &value, const String* descr, bool userValue)
 {
-  const XMLCh* tagProtoAttrParamName = L"name";
-  const XMLCh* tagParam = L"param";
-  const XMLCh* tagParamAttrParamName = L"name";
-  const XMLCh* tagParamAttrParamValue = L"value";
-  const XMLCh* tagParamAttrParamDescription = L"description";
-  const XMLCh* typeName = elem->getAttribute(tagProtoAttrParamName);
-  if (typeName == nullptr) {
-    return;
-  }
-  HRCParser* hrcParser = parserFactory->getHRCParser();
-  DString typenamed = DString(typeName);
-  FileTypeImpl* type = static_cast<FileTypeImpl*>(hrcParser->getFileType(&typenamed));
   if (type == nullptr) {
     return;
   }
 
-  for (xercesc::DOMNode* node = elem->getFirstChild(); node != nullptr; node = node->getNextSibling()) {
-    if (node->getNodeType() == xercesc::DOMNode::ELEMENT_NODE) {
-      xercesc::DOMElement* subelem = static_cast<xercesc::DOMElement*>(node);
-      if (xercesc::XMLString::equals(subelem->getNodeName(), tagParam)) {
-        const XMLCh* name = subelem->getAttribute(tagParamAttrParamName);
-        const XMLCh* value = subelem->getAttribute(tagParamAttrParamValue);
-        const XMLCh* descr = subelem->getAttribute(tagParamAttrParamDescription);
-
-        if (*name == '\0' || *value == '\0') {
-          continue;
-        }
-
-        if (type->getParamValue(DString(name)) == nullptr) {
-          type->addParam(&DString(name));
-        }
-        if (descr != nullptr) {
-          type->setParamDescription(DString(name), &DString(descr));
-        }
-        if (userValue) {
-          type->setParamValue(DString(name), &DString(value));
-        } else {
-          delete type->getParamDefaultValue(DString(name));
-          type->setParamDefaultValue(DString(name), &DString(value));
-        }
-      }
-    }
+  if (type->getParamValue(name) == nullptr) {
+    type->addParam(&name);
+  }
+  if (descr != nullptr) {
+    type->setParamDescription(name, descr);
+  }
+  if (userValue) {
+    type->setParamValue(name, &value);
+  } else {
+    delete type->getParamDefaultValue(name);
+    type->setParamDefaultValue(name, &value);
   }
 }
 
@@ -102,39 +157,27 @@ void FarHrcSettings::readProfileFromRegistry()
 {
   HRCParser* hrcParser = parserFactory->getHRCParser();
 
-  SettingsControl ColorerSettings;
-  size_t hrc_subkey;
-  hrc_subkey = ColorerSettings.rGetSubKey(0, HrcSettings);
-  FarSettingsEnum fse;
-  fse.StructSize = sizeof(FarSettingsEnum);
+  size_t hrc_subkey = settings->rOpenSubKey(0, HrcSettings);
+  if (!hrc_subkey) {
+    return;
+  }
+  const SettingsCache::Key* hrc_key = settings->getKey(hrc_subkey);
   // enum all the sections in HrcSettings
-  if (ColorerSettings.rEnum(hrc_subkey, &fse)) {
-    for (size_t i = 0; i < fse.Count; i++) {
-      if (fse.Items[i].Type == FST_SUBKEY) {
-        //check whether we have such a scheme
-        DString named = DString(fse.Items[i].Name);
-        FileTypeImpl* type = static_cast<FileTypeImpl*>(hrcParser->getFileType(&named));
-        if (type) {
-          // enum all params in the section
-          size_t type_subkey;
-          type_subkey = ColorerSettings.rGetSubKey(hrc_subkey, fse.Items[i].Name);
-          FarSettingsEnum type_fse;
-          type_fse.StructSize = sizeof(FarSettingsEnum);
-          if (ColorerSettings.rEnum(type_subkey, &type_fse)) {
-            for (size_t j = 0; j < type_fse.Count; j++) {
-              if (type_fse.Items[j].Type == FST_STRING) {
-                DString name_fse= DString(type_fse.Items[j].Name);
-                if (type->getParamValue(name_fse) == nullptr) {
-                  type->addParam(&name_fse);
-                }
-                const wchar_t* p = ColorerSettings.Get(type_subkey, type_fse.Items[j].Name, static_cast<wchar_t*>(nullptr));
-                if (p) {
-                  DString dp = DString(p);
-                  type->setParamValue(DString(type_fse.Items[j].Name), &dp);
-                }
-              }
-            }
+  for (auto subkey = hrc_key->subkeys.begin(); subkey != hrc_key->subkeys.end(); ++subkey) {
+    //check whether we have such a scheme
+    DString named = DString(subkey->first.c_str());
+    FileTypeImpl* type = static_cast<FileTypeImpl*>(hrcParser->getFileType(&named));
+    if (type) {
+      // enum all params in the section
+      const std::map<std::wstring, SettingsCache::Value> &values = subkey->second->values;
+      for (auto value = values.begin(); value != values.end(); ++value) {
+        if (value->second.type == FST_STRING) {
+          DString name_fse = DString(value->first.c_str());
+          if (type->getParamValue(name_fse) == nullptr) {
+            type->addParam(&name_fse);
           }
+          DString dp = DString(value->second.string.c_str());
+          type->setParamValue(name_fse, &dp);
         }
       }
     }
@@ -151,10 +194,8 @@ void FarHrcSettings::writeProfileToRegistry()
   HRCParser* hrcParser = parserFactory->getHRCParser();
   FileTypeImpl* type = nullptr;
 
-  SettingsControl ColorerSettings;
-  ColorerSettings.rDeleteSubKey(0, HrcSettings);
-  size_t hrc_subkey;
-  hrc_subkey = ColorerSettings.rGetSubKey(0, HrcSettings);
+  // the cache keeps only the values that differ from the saved ones
+  size_t hrc_subkey = settings->rGetSubKey(0, HrcSettings);
 
   // enum all FileTypes
   for (int idx = 0; ; idx++) {
@@ -164,15 +205,22 @@ void FarHrcSettings::writeProfileToRegistry()
       break;
     }
 
-    if (type->getParamCount() && type->getParamUserValueCount()) { // params>0 and user values >0
-      size_t type_subkey = ColorerSettings.rGetSubKey(hrc_subkey, type->getName()->getWChars());
-      // enum all params
-      std::vector<SString> type_params = type->enumParams();
-      for (auto paramname = type_params.begin(); paramname != type_params.end(); ++paramname) {
-        const String* v = type->getParamUserValue(*paramname);
-        if (v != nullptr) {
-          ColorerSettings.Set(type_subkey, paramname->getWChars(), v->getWChars());
-        }
+    size_t type_subkey = settings->rOpenSubKey(hrc_subkey, type->getName()->getWChars());
+    if (!type->getParamCount() || (!type->getParamUserValueCount() && !type_subkey)) {
+      continue;
+    }
+    if (!type_subkey) {
+      type_subkey = settings->rGetSubKey(hrc_subkey, type->getName()->getWChars());
+    }
+
+    // enum all params
+    std::vector<SString> type_params = type->enumParams();
+    for (auto paramname = type_params.begin(); paramname != type_params.end(); ++paramname) {
+      const String* v = type->getParamUserValue(*paramname);
+      if (v != nullptr) {
+        settings->Set(type_subkey, paramname->getWChars(), v->getWChars());
+      } else if (settings->Get(type_subkey, paramname->getWChars(), static_cast<wchar_t*>(nullptr)) != nullptr) {
+        settings->rDeleteSubKey(type_subkey, paramname->getWChars());
       }
     }
   }
@@ -5,6 +5,9 @@
 #include <colorer/HRCParser.h>
 #include <colorer/ParserFactory.h>
 
+class HrcSettingsCache;
+class SettingsCache;
+
 #define MAX_KEY_LENGTH 255
 #define MAX_VALUE_NAME 50 // in msdn 16383 , but we have enough 50
 
@@ -26,22 +29,26 @@ public:
 class FarHrcSettings
 {
   friend class FileTypeImpl;
+  friend class HrcSettingsHandler;
 public:
-  FarHrcSettings(ParserFactory* _parserFactory)
+  FarHrcSettings(ParserFactory* _parserFactory, SettingsCache* _settings)
   {
     parserFactory = _parserFactory;
+    settings = _settings;
   }
-  void readXML(String* file, bool userValue);
+  void readXML(String* file, bool userValue, HrcSettingsCache* cache = nullptr);
   void readProfile();
   void readUserProfile();
   void writeUserProfile();
 
 private:
-  void UpdatePrototype(xercesc::DOMElement* elem, bool userValue);
+  /** @param type nullptr if there is no such type */
+  void setPrototypeParam(FileTypeImpl* type, const String &name, const String &value, const String* descr, bool userValue);
   void readProfileFromRegistry();
   void writeProfileToRegistry();
 
   ParserFactory* parserFactory;
+  SettingsCache* settings;
 
 };
 
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <vector>
+#include "FileTypeCache.h"
+
+const unsigned int CACHE_MAGIC = 0x43544643; // "CFTC"
+const unsigned int CACHE_VERSION = 1;
+
+struct CacheHeader {
+  unsigned int magic;
+  unsigned int version;
+  unsigned __int64 stamp;
+  unsigned int count;
+  unsigned int reserved;
+};
+
+FileTypeCache::FileTypeCache(const String* cacheFile) :
+  cachePath(nullptr), stamp(0), useCounter(0), modified(false)
+{
+  if (cacheFile != nullptr) {
+    cachePath.reset(new SString(*cacheFile));
+  } else {
+    wchar_t profile[MAX_PATH];
+    DWORD len = GetEnvironmentVariableW(L"FARLOCALPROFILE", profile, MAX_PATH);
+    if (len > 0 && len < MAX_PATH) {
+      StringBuffer path;
+      path.append(DString(profile)).append(DString(FileTypeCacheName));
+      cachePath.reset(new SString(path));
+    }
+  }
+}
+
+void FileTypeCache::clear(unsigned __int64 baseStamp)
+{
+  modified = modified || !entries.empty() || stamp != baseStamp;
+  entries.clear();
+  stamp = baseStamp;
+  useCounter = 0;
+}
+
+void FileTypeCache::load(unsigned __int64 baseStamp)
+{
+  clear(baseStamp);
+  if (cachePath == nullptr) {
+    return;
+  }
+
+  HANDLE file = CreateFileW(cachePath->getWChars(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  LARGE_INTEGER size;
+  std::vector<char> data;
+  if (GetFileSizeEx(file, &size) && size.QuadPart >= (LONGLONG)sizeof(CacheHeader) && size.QuadPart < 0x1000000) {
+    data.resize(static_cast<size_t>(size.QuadPart));
+    DWORD read = 0;
+    if (!ReadFile(file, data.data(), static_cast<DWORD>(data.size()), &read, nullptr) || read != data.size()) {
+      data.clear();
+    }
+  }
+  CloseHandle(file);
+  if (data.empty()) {
+    return;
+  }
+
+  CacheHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.stamp != baseStamp) {
+    return;
+  }
+
+  // records: hash, length of the file name, length of the type name, the names
+  size_t pos = sizeof(CacheHeader);
+  for (unsigned int i = 0; i < header.count; i++) {
+    unsigned int rec[3];
+    if (pos + sizeof(rec) > data.size()) {
+      break;
+    }
+    memcpy(rec, &data[pos], sizeof(rec));
+    pos += sizeof(rec);
+    size_t bytes = (static_cast<size_t>(rec[1]) + rec[2]) * sizeof(wchar_t);
+    if (pos + bytes > data.size()) {
+      break;
+    }
+    const wchar_t* names = reinterpret_cast<const wchar_t*>(&data[pos]);
+    pos += bytes;
+    Entry entry;
+    entry.textHash = rec[0];
+    entry.typeName.assign(names + rec[1], rec[2]);
+    // the file written first was used most recently
+    entry.lastUse = header.count - i;
+    entries[std::wstring(names, rec[1])] = entry;
+  }
+  useCounter = header.count;
+  modified = false;
+}
+
+bool FileTypeCache::save()
+{
+  if (!modified || cachePath == nullptr) {
+    return false;
+  }
+
+  // the most recently used files go first
+  std::vector<const std::pair<const std::wstring, Entry>*> order;
+  order.reserve(entries.size());
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    order.push_back(&*it);
+  }
+  std::sort(order.begin(), order.end(), [](const std::pair<const std::wstring, Entry>* a, const std::pair<const std::wstring, Entry>* b) {
+    return a->second.lastUse > b->second.lastUse;
+  });
+
+  std::vector<char> data(sizeof(CacheHeader));
+  CacheHeader header;
+  header.magic = CACHE_MAGIC;
+  header.version = CACHE_VERSION;
+  header.stamp = stamp;
+  header.count = static_cast<unsigned int>(order.size());
+  header.reserved = 0;
+  memcpy(data.data(), &header, sizeof(header));
+  for (auto it = order.begin(); it != order.end(); ++it) {
+    const std::wstring &fileName = (*it)->first;
+    const Entry &entry = (*it)->second;
+    unsigned int rec[3] = { entry.textHash, static_cast<unsigned int>(fileName.length()), static_cast<unsigned int>(entry.typeName.length()) };
+    size_t pos = data.size();
+    data.resize(pos + sizeof(rec) + (fileName.length() + entry.typeName.length()) * sizeof(wchar_t));
+    memcpy(&data[pos], rec, sizeof(rec));
+    pos += sizeof(rec);
+    memcpy(&data[pos], fileName.data(), fileName.length() * sizeof(wchar_t));
+    pos += fileName.length() * sizeof(wchar_t);
+    memcpy(&data[pos], entry.typeName.data(), entry.typeName.length() * sizeof(wchar_t));
+  }
+
+  // the new cache replaces the old one only when it is written completely
+  StringBuffer tmpPath(cachePath.get());
+  tmpPath.append(DString(".tmp"));
+  HANDLE out = CreateFileW(tmpPath.getWChars(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (out == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  DWORD written = 0;
+  bool res = WriteFile(out, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) && written == data.size();
+  CloseHandle(out);
+
+  if (res) {
+    res = !!MoveFileExW(tmpPath.getWChars(), cachePath->getWChars(), MOVEFILE_REPLACE_EXISTING);
+  }
+  if (!res) {
+    DeleteFileW(tmpPath.getWChars());
+  } else {
+    modified = false;
+  }
+  return res;
+}
+
+const std::wstring* FileTypeCache::find(const std::wstring &fileName, unsigned int textHash)
+{
+  auto it = entries.find(fileName);
+  if (it == entries.end() || it->second.textHash != textHash) {
+    return nullptr;
+  }
+  it->second.lastUse = ++useCounter;
+  modified = true;
+  return &it->second.typeName;
+}
+
+void FileTypeCache::add(const std::wstring &fileName, unsigned int textHash, const String &typeName)
+{
+  auto it = entries.find(fileName);
+  if (it == entries.end() && entries.size() >= cFileTypeCacheMax) {
+    removeOldest();
+  }
+  Entry &entry = entries[fileName];
+  entry.typeName.assign(typeName.getWChars(), typeName.length());
+  entry.textHash = textHash;
+  entry.lastUse = ++useCounter;
+  modified = true;
+}
+
+void FileTypeCache::removeOldest()
+{
+  auto oldest = entries.begin();
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->second.lastUse < oldest->second.lastUse) {
+      oldest = it;
+    }
+  }
+  if (oldest != entries.end()) {
+    entries.erase(oldest);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef _FILETYPECACHE_H_
+#define _FILETYPECACHE_H_
+
+#include <string>
+#include <unordered_map>
+#include "pcolorer.h"
+
+const wchar_t FileTypeCacheName[] = L"\\PluginsData\\colorer.filetypes.cache";
+// number of remembered files
+const size_t cFileTypeCacheMax = 1024;
+
+/** File types chosen for the files by the patterns of the database.
+    The decision depends on the file name and the start of the text,
+    so it is remembered for the full file name with the hash of the
+    text start. The cache is kept between sessions and is valid while
+    the stamp of the database is the same.
+    @ingroup far_plugin
+*/
+class FileTypeCache
+{
+public:
+  /** @param cacheFile the cache, nullptr to use the default one in the Far local profile
+  */
+  FileTypeCache(const String* cacheFile = nullptr);
+
+  /** Reads the cache written for the database with the same stamp.
+      Otherwise the cache becomes empty.
+  */
+  void load(unsigned __int64 baseStamp);
+  /** Writes the cache, if it was changed */
+  bool save();
+  /** Forgets all the files, the new database is used */
+  void clear(unsigned __int64 baseStamp);
+
+  /** Returns the name of the type chosen for the file, or nullptr */
+  const std::wstring* find(const std::wstring &fileName, unsigned int textHash);
+  void add(const std::wstring &fileName, unsigned int textHash, const String &typeName);
+
+private:
+  struct Entry {
+    std::wstring typeName;
+    unsigned int textHash;
+    /** value of useCounter at the last use */
+    unsigned int lastUse;
+  };
+
+  std::unique_ptr<SString> cachePath;
+  std::unordered_map<std::wstring, Entry> entries;
+  unsigned __int64 stamp;
+  unsigned int useCounter;
+  bool modified;
+
+  void removeOldest();
+};
+
+#endif
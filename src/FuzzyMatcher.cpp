@@ -0,0 +1,163 @@
+#include <unicode/Character.h>
+#include "FuzzyMatcher.h"
+
+// score weights, close to fzf ones
+const int SCORE_MATCH = 16;
+const int PENALTY_GAP = 3;
+const int BONUS_BOUNDARY = 8;
+const int BONUS_CONSECUTIVE = 4;
+const int BONUS_FIRST_CHAR = 8;
+const int BONUS_SUBSTRING = 16;
+
+FuzzyMatcher::FuzzyMatcher()
+{
+}
+
+void FuzzyMatcher::clear()
+{
+  text.clear();
+  offsets.clear();
+  masks.clear();
+  substring.clear();
+  matched.clear();
+  lastPattern.clear();
+}
+
+unsigned __int64 FuzzyMatcher::charMask(wchar_t c)
+{
+  if (c >= 'a' && c <= 'z') {
+    return 1ull << (c - 'a');
+  }
+  if (c >= '0' && c <= '9') {
+    return 1ull << (26 + c - '0');
+  }
+  return 1ull << (36 + c % 28);
+}
+
+size_t FuzzyMatcher::add(const String* str)
+{
+  size_t idx = masks.size();
+  unsigned __int64 mask = 0;
+  offsets.push_back(text.size());
+  for (int i = 0; i < str->length(); i++) {
+    wchar_t c = Character::toLowerCase((*str)[i]);
+    text.push_back(c);
+    mask |= charMask(c);
+  }
+  text.push_back(0);
+  masks.push_back(mask);
+  substring.push_back(-1);
+  // new candidate, so the previous results can't be narrowed
+  lastPattern.clear();
+  return idx;
+}
+
+size_t FuzzyMatcher::match(const wchar_t* pattern, std::vector<int> &scores)
+{
+  size_t items = masks.size();
+  size_t plen = wcslen(pattern);
+  scores.assign(items, -1);
+
+  unsigned __int64 pmask = 0;
+  for (size_t i = 0; i < plen; i++) {
+    pmask |= charMask(pattern[i]);
+  }
+
+  // typing of one more char - check only what matched before
+  bool narrow = !lastPattern.empty() && plen >= lastPattern.length() && lastPattern.compare(0, lastPattern.length(), pattern, lastPattern.length()) == 0;
+
+  checked.clear();
+  if (narrow) {
+    for (auto it = matched.begin(); it != matched.end(); ++it) {
+      if ((masks[*it] & pmask) == pmask) {
+        checked.push_back(*it);
+      }
+    }
+  } else {
+    // each index is written, the count grows only for a match, so the loop has no branch to mispredict
+    checked.resize(items);
+    const unsigned __int64* m = masks.data();
+    size_t count = 0;
+    for (size_t i = 0; i < items; i++) {
+      checked[count] = i;
+      count += (m[i] & pmask) == pmask;
+    }
+    checked.resize(count);
+  }
+
+  matched.clear();
+  for (auto it = checked.begin(); it != checked.end(); ++it) {
+    int sc = score(*it, pattern, plen);
+    if (sc >= 0) {
+      scores[*it] = sc;
+      matched.push_back(*it);
+    }
+  }
+  lastPattern.assign(pattern, plen);
+
+  return matched.size();
+}
+
+int FuzzyMatcher::score(size_t item, const wchar_t* pattern, size_t plen)
+{
+  const wchar_t* s = getText(item);
+  size_t len = (item + 1 < offsets.size() ? offsets[item + 1] : text.size()) - offsets[item] - 1;
+
+  const wchar_t* sub = plen ? wcsstr(s, pattern) : s;
+  substring[item] = sub ? static_cast<int>(sub - s) : -1;
+  if (plen == 0) {
+    return 0;
+  }
+
+  // forward scan - is pattern a subsequence at all
+  size_t pi = 0;
+  size_t last = 0;
+  for (size_t i = 0; i < len && pi < plen; i++) {
+    if (s[i] == pattern[pi]) {
+      pi++;
+      last = i + 1;
+    }
+  }
+  if (pi < plen) {
+    return -1;
+  }
+
+  // backward scan - the shortest window ending at the last matched char
+  size_t start = last;
+  for (pi = plen; pi > 0;) {
+    start--;
+    if (s[start] == pattern[pi - 1]) {
+      pi--;
+    }
+  }
+
+  int sc = 0;
+  bool consecutive = false;
+  pi = 0;
+  for (size_t i = start; i < last && pi < plen; i++) {
+    if (s[i] == pattern[pi]) {
+      sc += SCORE_MATCH;
+      if (i == 0 || !Character::isLetterOrDigit(s[i - 1])) {
+        sc += BONUS_BOUNDARY;
+      }
+      if (consecutive) {
+        sc += BONUS_CONSECUTIVE;
+      }
+      consecutive = true;
+      pi++;
+    } else {
+      consecutive = false;
+      sc -= PENALTY_GAP;
+    }
+  }
+  if (start == 0) {
+    sc += BONUS_FIRST_CHAR;
+  }
+  if (sub != nullptr) {
+    sc += BONUS_SUBSTRING;
+  }
+  // shorter candidates go first
+  sc -= static_cast<int>(len / 16);
+
+  return sc < 0 ? 0 : sc;
+}
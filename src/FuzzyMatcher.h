@@ -0,0 +1,60 @@
+#ifndef _FUZZYMATCHER_H_
+#define _FUZZYMATCHER_H_
+
+#include <vector>
+#include <string>
+#include <unicode/String.h>
+
+/** Subsequence matcher with scoring for menu filters.
+    Candidates are stored lowercased in one buffer. Each candidate
+    has a bitmask of its characters, so candidates without some of
+    the pattern characters are rejected without scanning the text.
+    When the pattern extends the previous one, only previously
+    matched candidates are checked.
+    @ingroup far_plugin
+*/
+class FuzzyMatcher
+{
+public:
+  FuzzyMatcher();
+
+  void clear();
+  /** Adds candidate string, returns its index */
+  size_t add(const String* text);
+  size_t count() const
+  {
+    return masks.size();
+  }
+
+  /** Matches the pattern with all candidates.
+      @param scores filled with score for each candidate, -1 - doesn't match
+      @return count of matched candidates
+  */
+  size_t match(const wchar_t* pattern, std::vector<int> &scores);
+  /** Position of the last pattern as a substring of the candidate, or -1 */
+  int getSubstring(size_t item) const
+  {
+    return substring[item];
+  }
+  /** Lowercased candidate text */
+  const wchar_t* getText(size_t item) const
+  {
+    return &text[offsets[item]];
+  }
+
+private:
+  std::vector<wchar_t> text;
+  std::vector<size_t> offsets;
+  std::vector<unsigned __int64> masks;
+  std::vector<int> substring;
+
+  std::wstring lastPattern;
+  /** candidates matched the last pattern */
+  std::vector<size_t> matched;
+  std::vector<size_t> checked;
+
+  static unsigned __int64 charMask(wchar_t c);
+  int score(size_t item, const wchar_t* pattern, size_t plen);
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "HrcSettingsCache.h"
+
+const unsigned int CACHE_MAGIC = 0x43485343; // "CSHC"
+const unsigned int CACHE_VERSION = 1;
+
+struct CacheHeader {
+  unsigned int magic;
+  unsigned int version;
+  unsigned __int64 sourceSize;
+  unsigned __int64 sourceTime;
+  unsigned int count;
+  unsigned int reserved;
+};
+
+HrcSettingsCache::HrcSettingsCache(const String* sourceFile, const String* cacheFile) :
+  sourcePath(nullptr), cachePath(nullptr), sourceSize(0), sourceTime(0), sourceFound(false),
+  file(INVALID_HANDLE_VALUE), mapping(nullptr), view(nullptr), viewSize(0), readPos(0), writeCount(0)
+{
+  sourcePath.reset(new SString(*sourceFile));
+  if (cacheFile != nullptr) {
+    cachePath.reset(new SString(*cacheFile));
+  } else {
+    wchar_t profile[MAX_PATH];
+    DWORD len = GetEnvironmentVariableW(L"FARLOCALPROFILE", profile, MAX_PATH);
+    if (len > 0 && len < MAX_PATH) {
+      StringBuffer path;
+      path.append(DString(profile)).append(DString(HrcSettingsCacheName));
+      cachePath.reset(new SString(path));
+    }
+  }
+
+  WIN32_FILE_ATTRIBUTE_DATA fad;
+  if (GetFileAttributesExW(sourcePath->getWChars(), GetFileExInfoStandard, &fad)) {
+    sourceFound = true;
+    sourceSize = (static_cast<unsigned __int64>(fad.nFileSizeHigh) << 32) | fad.nFileSizeLow;
+    sourceTime = (static_cast<unsigned __int64>(fad.ftLastWriteTime.dwHighDateTime) << 32) | fad.ftLastWriteTime.dwLowDateTime;
+  }
+}
+
+HrcSettingsCache::~HrcSettingsCache()
+{
+  close();
+}
+
+void HrcSettingsCache::close()
+{
+  if (view) {
+    UnmapViewOfFile(view);
+    view = nullptr;
+  }
+  if (mapping) {
+    CloseHandle(mapping);
+    mapping = nullptr;
+  }
+  if (file != INVALID_HANDLE_VALUE) {
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+  }
+  viewSize = 0;
+  readPos = 0;
+}
+
+bool HrcSettingsCache::load()
+{
+  close();
+  if (!sourceFound || cachePath == nullptr) {
+    return false;
+  }
+
+  file = CreateFileW(cachePath->getWChars(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(CacheHeader)) {
+    close();
+    return false;
+  }
+  mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping) {
+    view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (!view) {
+    close();
+    return false;
+  }
+  viewSize = static_cast<size_t>(size.QuadPart);
+
+  CacheHeader header;
+  memcpy(&header, view, sizeof(header));
+  if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION ||
+      header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+    close();
+    return false;
+  }
+
+  // a truncated or broken cache is not used at all, so the parameters are never applied partially
+  readPos = sizeof(CacheHeader);
+  Record record;
+  unsigned int count = 0;
+  while (readPos < viewSize && readRecord(record)) {
+    count++;
+  }
+  if (count != header.count || readPos != viewSize) {
+    close();
+    return false;
+  }
+  readPos = sizeof(CacheHeader);
+  return true;
+}
+
+bool HrcSettingsCache::readString(const wchar_t* &str, int &len)
+{
+  if (readPos + sizeof(int) > viewSize) {
+    return false;
+  }
+  memcpy(&len, view + readPos, sizeof(int));
+  readPos += sizeof(int);
+  if (len < 0) {
+    str = nullptr;
+    len = 0;
+    return true;
+  }
+  if (static_cast<size_t>(len) > (viewSize - readPos) / sizeof(wchar_t)) {
+    return false;
+  }
+  str = reinterpret_cast<const wchar_t*>(view + readPos);
+  readPos += len * sizeof(wchar_t);
+  return true;
+}
+
+bool HrcSettingsCache::next(Record &record)
+{
+  if (!view || readPos >= viewSize) {
+    return false;
+  }
+  return readRecord(record);
+}
+
+bool HrcSettingsCache::readRecord(Record &record)
+{
+  return readString(record.type, record.typeLength) && readString(record.name, record.nameLength) &&
+         readString(record.value, record.valueLength) && readString(record.description, record.descriptionLength);
+}
+
+void HrcSettingsCache::writeString(const wchar_t* str, int len)
+{
+  size_t pos = writeBuffer.size();
+  size_t bytes = str ? len * sizeof(wchar_t) : 0;
+  writeBuffer.resize(pos + sizeof(int) + bytes);
+  int l = str ? len : -1;
+  memcpy(&writeBuffer[pos], &l, sizeof(int));
+  if (bytes) {
+    memcpy(&writeBuffer[pos + sizeof(int)], str, bytes);
+  }
+}
+
+void HrcSettingsCache::add(const String &type, const String &name, const String &value, const String* description)
+{
+  writeString(type.getWChars(), type.length());
+  writeString(name.getWChars(), name.length());
+  writeString(value.getWChars(), value.length());
+  writeString(description ? description->getWChars() : nullptr, description ? description->length() : 0);
+  writeCount++;
+}
+
+bool HrcSettingsCache::save()
+{
+  if (!sourceFound || cachePath == nullptr) {
+    return false;
+  }
+  close();
+
+  CacheHeader header;
+  header.magic = CACHE_MAGIC;
+  header.version = CACHE_VERSION;
+  header.sourceSize = sourceSize;
+  header.sourceTime = sourceTime;
+  header.count = writeCount;
+  header.reserved = 0;
+
+  // the new cache replaces the old one only when it is written completely
+  StringBuffer tmpPath(cachePath.get());
+  tmpPath.append(DString(".tmp"));
+  HANDLE out = CreateFileW(tmpPath.getWChars(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (out == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  DWORD written = 0;
+  bool res = WriteFile(out, &header, sizeof(header), &written, nullptr) && written == sizeof(header);
+  if (res && !writeBuffer.empty()) {
+    res = WriteFile(out, writeBuffer.data(), static_cast<DWORD>(writeBuffer.size()), &written, nullptr) && written == writeBuffer.size();
+  }
+  CloseHandle(out);
+
+  if (res) {
+    res = !!MoveFileExW(tmpPath.getWChars(), cachePath->getWChars(), MOVEFILE_REPLACE_EXISTING);
+  }
+  if (!res) {
+    DeleteFileW(tmpPath.getWChars());
+  }
+  return res;
+}
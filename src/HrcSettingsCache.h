@@ -0,0 +1,73 @@
+#ifndef _HRCSETTINGSCACHE_H_
+#define _HRCSETTINGSCACHE_H_
+
+#include <vector>
+#include "pcolorer.h"
+
+const wchar_t HrcSettingsCacheName[] = L"\\PluginsData\\colorer.hrcsettings.cache";
+
+/** Binary cache of the prototype parameters read from hrcsettings.xml.
+    Parameters are stored in the order of the source file. The cache is
+    valid while the size and the modification time of the source file
+    are the same as at the moment of writing. The cache is read through
+    the file mapping, so the loaded records point into the mapped view.
+    @ingroup far_plugin
+*/
+class HrcSettingsCache
+{
+public:
+  struct Record {
+    const wchar_t* type;
+    int typeLength;
+    const wchar_t* name;
+    int nameLength;
+    const wchar_t* value;
+    int valueLength;
+    /** nullptr if the parameter has no description */
+    const wchar_t* description;
+    int descriptionLength;
+  };
+
+  /** @param sourceFile hrcsettings.xml
+      @param cacheFile the cache, nullptr to use the default one in the Far local profile
+  */
+  HrcSettingsCache(const String* sourceFile, const String* cacheFile = nullptr);
+  ~HrcSettingsCache();
+
+  /** Maps the cache into memory and checks all its records.
+      @return false if there is no cache, it is out of date, or the number
+              of the records differs from the header
+  */
+  bool load();
+  /** Returns the next record of the loaded cache, or false at the end */
+  bool next(Record &record);
+
+  /** Adds parameter to the new cache */
+  void add(const String &type, const String &name, const String &value, const String* description);
+  /** Writes the new cache */
+  bool save();
+
+private:
+  std::unique_ptr<SString> sourcePath;
+  std::unique_ptr<SString> cachePath;
+  /** size and modification time of the source file */
+  unsigned __int64 sourceSize;
+  unsigned __int64 sourceTime;
+  bool sourceFound;
+
+  HANDLE file;
+  HANDLE mapping;
+  const char* view;
+  size_t viewSize;
+  size_t readPos;
+
+  std::vector<char> writeBuffer;
+  unsigned int writeCount;
+
+  void close();
+  void writeString(const wchar_t* str, int len);
+  bool readString(const wchar_t* &str, int &len);
+  bool readRecord(Record &record);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "HrdSetsReader.h"
+#include <xercesc/sax2/Attributes.hpp>
+
+HrdSetsReader::HrdSetsReader(ParserFactory* pf) :
+  parserFactory(pf), document(nullptr), depth(0), rootFound(false)
+{
+}
+
+HrdSetsReader::~HrdSetsReader()
+{
+  if (document != nullptr) {
+    document->release();
+  }
+}
+
+void HrdSetsReader::startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname,
+                                 const xercesc::Attributes &attrs)
+{
+  depth++;
+  if (depth == 1) {
+    rootFound = xercesc::XMLString::equals(qname, L"hrd-sets");
+    return;
+  }
+  if (!rootFound || (depth == 2 && !xercesc::XMLString::equals(qname, L"hrd")) || (depth > 2 && elements.empty())) {
+    return;
+  }
+
+  if (document == nullptr) {
+    document = xercesc::DOMImplementation::getImplementation()->createDocument();
+  }
+  xercesc::DOMElement* elem = document->createElement(qname);
+  for (XMLSize_t idx = 0; idx < attrs.getLength(); idx++) {
+    elem->setAttribute(attrs.getQName(idx), attrs.getValue(idx));
+  }
+  if (elements.empty()) {
+    document->appendChild(elem);
+  } else {
+    elements.back()->appendChild(elem);
+  }
+  elements.push_back(elem);
+}
+
+void HrdSetsReader::endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname)
+{
+  depth--;
+  if (elements.empty()) {
+    return;
+  }
+  xercesc::DOMElement* elem = elements.back();
+  elements.pop_back();
+  if (elements.empty()) {
+    // the document holds one element, it is removed before the next hrd
+    document->removeChild(elem);
+    try {
+      parserFactory->parseHRDSetsChild(elem);
+    } catch (...) {
+      elem->release();
+      throw;
+    }
+    elem->release();
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef _HRDSETSREADER_H_
+#define _HRDSETSREADER_H_
+
+#include <vector>
+#include <colorer/ParserFactory.h>
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/dom/DOM.hpp>
+
+/** Streaming reader of a user hrd-sets file.
+    ParserFactory takes a DOM element for each hrd, so only the element
+    of the current hrd is built and it is released after parsing.
+    @ingroup far_plugin
+*/
+class HrdSetsReader : public xercesc::DefaultHandler
+{
+public:
+  HrdSetsReader(ParserFactory* pf);
+  ~HrdSetsReader();
+
+  void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname,
+                    const xercesc::Attributes &attrs);
+  void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname);
+
+  /** false if the root element is not hrd-sets */
+  bool isRootFound() const
+  {
+    return rootFound;
+  }
+
+private:
+  ParserFactory* parserFactory;
+  xercesc::DOMDocument* document;
+  /** elements of the current hrd from its root */
+  std::vector<xercesc::DOMElement*> elements;
+  int depth;
+  bool rootFound;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <climits>
+#include "LineRegionIndex.h"
+
+LineRegionIndex::LineRegionIndex()
+{
+}
+
+void LineRegionIndex::clear()
+{
+  intervals.clear();
+  maxEnd.clear();
+}
+
+void LineRegionIndex::build(LineRegion* lineRegions)
+{
+  clear();
+  size_t order = 0;
+  for (LineRegion* l1 = lineRegions; l1; l1 = l1->next, order++) {
+    if (l1->special || l1->start == l1->end) {
+      continue;
+    }
+    Interval in = {l1->start, l1->end == -1 ? INT_MAX : l1->end, order, l1};
+    intervals.push_back(in);
+  }
+
+  std::stable_sort(intervals.begin(), intervals.end(), [](const Interval & a, const Interval & b) {
+    return a.start < b.start;
+  });
+
+  int max_end = INT_MIN;
+  for (auto it = intervals.begin(); it != intervals.end(); ++it) {
+    if (it->end > max_end) {
+      max_end = it->end;
+    }
+    maxEnd.push_back(max_end);
+  }
+}
+
+const LineRegion* LineRegionIndex::innermost(int pos) const
+{
+  auto last = std::upper_bound(intervals.begin(), intervals.end(), pos, [](int p, const Interval & a) {
+    return p < a.start;
+  });
+
+  const Interval* best = nullptr;
+  for (size_t i = last - intervals.begin(); i > 0 && maxEnd[i - 1] >= pos; i--) {
+    const Interval &in = intervals[i - 1];
+    if (in.end >= pos && (best == nullptr || in.order > best->order)) {
+      best = &in;
+    }
+  }
+  return best ? best->region : nullptr;
+}
+
+size_t LineRegionIndex::enclosing(int pos, std::vector<const LineRegion*> &chain) const
+{
+  chain.clear();
+  size_t count = collect(pos, found_cache);
+  for (size_t i = 0; i < count; i++) {
+    chain.push_back(found_cache[i]->region);
+  }
+  return count;
+}
+
+size_t LineRegionIndex::collect(int pos, std::vector<const Interval*> &found) const
+{
+  found.clear();
+  auto last = std::upper_bound(intervals.begin(), intervals.end(), pos, [](int p, const Interval & a) {
+    return p < a.start;
+  });
+
+  for (size_t i = last - intervals.begin(); i > 0 && maxEnd[i - 1] >= pos; i--) {
+    if (intervals[i - 1].end >= pos) {
+      found.push_back(&intervals[i - 1]);
+    }
+  }
+
+  std::sort(found.begin(), found.end(), [](const Interval * a, const Interval * b) {
+    return a->order > b->order;
+  });
+  return found.size();
+}
@@ -0,0 +1,50 @@
+#ifndef _LINEREGIONINDEX_H_
+#define _LINEREGIONINDEX_H_
+
+#include <vector>
+#include <colorer/handlers/LineRegion.h>
+
+/** Interval index over the LineRegion list of one line.
+    Regions are kept sorted by start with a running maximum
+    of ends, so a column query stops as soon as no region
+    to the left can reach the column.
+    Storage is reused between builds.
+    @ingroup far_plugin
+*/
+class LineRegionIndex
+{
+public:
+  LineRegionIndex();
+
+  /** Rebuilds index from the line regions list. Regions with end == -1 lasts up to the end of line.
+  */
+  void build(LineRegion* lineRegions);
+  void clear();
+
+  /** Returns the innermost region at the column, or nullptr.
+  */
+  const LineRegion* innermost(int pos) const;
+  /** Fills chain with the regions enclosing the column, from innermost to outermost.
+      @return size of chain
+  */
+  size_t enclosing(int pos, std::vector<const LineRegion*> &chain) const;
+
+private:
+  struct Interval {
+    int start;
+    int end;
+    /** position in the LineRegion list, later regions are nested */
+    size_t order;
+    const LineRegion* region;
+  };
+
+  std::vector<Interval> intervals;
+  /** maxEnd[i] - the maximum end of intervals [0..i] */
+  std::vector<int> maxEnd;
+
+  /** Collects intervals covering pos, sorted by order descending */
+  size_t collect(int pos, std::vector<const Interval*> &found) const;
+  mutable std::vector<const Interval*> found_cache;
+};
+
+#endif
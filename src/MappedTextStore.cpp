@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <chrono>
+#include "MappedTextStore.h"
+
+// size of the view for reading lines
+const size_t cTextViewSize = 4 * 1024 * 1024;
+// size of the view of the indexing thread
+const size_t cIndexViewSize = 16 * 1024 * 1024;
+// the rest of longer lines isn't shown
+const size_t cMaxLineBytes = 1024 * 1024;
+const int cTabSize = 8;
+
+MappedTextStore::MappedTextStore() :
+  fileName(nullptr), tab2spaces(false), file(INVALID_HANDLE_VALUE), mapping(nullptr), fileSize(0), textStart(0),
+  encoding(TE_ANSI), unitSize(1), granularity(0x10000), view(nullptr), viewStart(0), viewSize(0),
+  lineCount(0), indexed(false), stop(false), lastLine(SIZE_MAX), lastLineStart(0), lineCache(cLineCacheSize), nextCacheSlot(0)
+{
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  granularity = si.dwAllocationGranularity;
+}
+
+MappedTextStore::~MappedTextStore()
+{
+  close();
+}
+
+void MappedTextStore::close()
+{
+  stop = true;
+  if (indexer.joinable()) {
+    indexer.join();
+  }
+  if (view) {
+    UnmapViewOfFile(view);
+    view = nullptr;
+  }
+  if (mapping) {
+    CloseHandle(mapping);
+    mapping = nullptr;
+  }
+  if (file != INVALID_HANDLE_VALUE) {
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+  }
+}
+
+void MappedTextStore::open(const String* fileName_, bool tab2spaces_)
+{
+  close();
+  fileName.reset(new SString(*fileName_));
+  tab2spaces = tab2spaces_;
+
+  file = CreateFileW(fileName->getWChars(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  LARGE_INTEGER size;
+  if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) {
+    StringBuffer msg("Can't open file: ");
+    msg.append(fileName.get());
+    throw Exception(msg);
+  }
+  fileSize = static_cast<unsigned __int64>(size.QuadPart);
+
+  lineIndex.clear();
+  lineIndex.push_back(0);
+  lineCount = 1;
+  stop = false;
+  indexed = true;
+  if (fileSize == 0) {
+    return;
+  }
+
+  mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  const char* bom = mapping ? mapView(0, static_cast<size_t>(std::min<unsigned __int64>(fileSize, 3))) : nullptr;
+  if (!bom) {
+    StringBuffer msg("Can't map file: ");
+    msg.append(fileName.get());
+    throw Exception(msg);
+  }
+
+  textStart = detectBom(bom, static_cast<size_t>(std::min<unsigned __int64>(fileSize, 3)), encoding);
+  unitSize = (encoding == TE_UTF16LE || encoding == TE_UTF16BE) ? 2 : 1;
+
+  lineIndex[0] = textStart;
+  indexed = false;
+  indexer = std::thread(&MappedTextStore::indexLines, this);
+}
+
+void MappedTextStore::waitForLines(size_t count) const
+{
+  while (!indexed && lineCount < count) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void MappedTextStore::indexLines()
+{
+  // the thread maps its own views, the reading view belongs to the caller
+  std::vector<unsigned __int64> found;
+  size_t count = 1;
+  unsigned __int64 pos = textStart;
+  while (pos < fileSize && !stop) {
+    unsigned __int64 start = pos - pos % granularity;
+    size_t size = static_cast<size_t>(std::min<unsigned __int64>(fileSize - start, cIndexViewSize));
+    const char* chunk = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32),
+                                                               static_cast<DWORD>(start), size));
+    if (!chunk) {
+      break;
+    }
+    const char* end = chunk + size;
+    for (const char* p = chunk + (pos - start); (p = findLineFeed(encoding, p, end)) != nullptr; count++) {
+      p += unitSize;
+      if (count % cLineIndexStep == 0) {
+        found.push_back(start + (p - chunk));
+      }
+    }
+    UnmapViewOfFile(chunk);
+    pos = start + size;
+
+    {
+      std::lock_guard<std::mutex> guard(indexLock);
+      lineIndex.insert(lineIndex.end(), found.begin(), found.end());
+    }
+    found.clear();
+    lineCount = count;
+  }
+  indexed = true;
+}
+
+const char* MappedTextStore::mapView(unsigned __int64 offset, size_t size)
+{
+  if (view && offset >= viewStart && offset + size <= viewStart + viewSize) {
+    return view + (offset - viewStart);
+  }
+  if (view) {
+    UnmapViewOfFile(view);
+    view = nullptr;
+  }
+  viewStart = offset - offset % granularity;
+  viewSize = std::max<size_t>(cTextViewSize, static_cast<size_t>(offset - viewStart) + size);
+  viewSize = static_cast<size_t>(std::min<unsigned __int64>(viewSize, fileSize - viewStart));
+  view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(viewStart >> 32),
+                                                static_cast<DWORD>(viewStart), viewSize));
+  if (!view) {
+    viewSize = 0;
+    return nullptr;
+  }
+  return view + (offset - viewStart);
+}
+
+unsigned __int64 MappedTextStore::findLineEnd(unsigned __int64 lineStart)
+{
+  unsigned __int64 pos = lineStart;
+  while (pos < fileSize) {
+    size_t size = static_cast<size_t>(std::min<unsigned __int64>(fileSize - pos, cTextViewSize));
+    const char* start = mapView(pos, size);
+    if (!start) {
+      break;
+    }
+    const char* lf = findLineFeed(encoding, start, start + size);
+    if (lf) {
+      return pos + (lf - start);
+    }
+    pos += size;
+  }
+  return fileSize;
+}
+
+String* MappedTextStore::getLine(size_t lno)
+{
+  if (lno >= lineCount) {
+    return nullptr;
+  }
+  for (auto it = lineCache.begin(); it != lineCache.end(); ++it) {
+    if (it->text && it->lno == lno) {
+      return it->text.get();
+    }
+  }
+
+  size_t line;
+  unsigned __int64 pos;
+  if (lastLine <= lno && lno / cLineIndexStep == lastLine / cLineIndexStep) {
+    // parser reads the lines one by one
+    line = lastLine;
+    pos = lastLineStart;
+  } else {
+    std::lock_guard<std::mutex> guard(indexLock);
+    line = lno - lno % cLineIndexStep;
+    pos = lineIndex[lno / cLineIndexStep];
+  }
+  for (; line < lno; line++) {
+    pos = findLineEnd(pos) + unitSize;
+  }
+  lastLine = lno;
+  lastLineStart = pos;
+
+  CachedLine &cached = lineCache[nextCacheSlot];
+  nextCacheSlot = (nextCacheSlot + 1) % cLineCacheSize;
+  cached.lno = lno;
+  cached.text.reset(decode(pos, findLineEnd(pos)));
+  return cached.text.get();
+}
+
+SString* MappedTextStore::decode(unsigned __int64 start, unsigned __int64 end)
+{
+  if (start >= end || !mapping) {
+    return new SString(DString(""));
+  }
+  size_t size = static_cast<size_t>(std::min<unsigned __int64>(end - start, cMaxLineBytes));
+  size -= size % unitSize;
+  const char* data = mapView(start, size);
+  if (!data) {
+    return new SString(DString(""));
+  }
+
+  std::vector<wchar_t> text;
+  decodeText(encoding, data, size, text);
+  if (!text.empty() && text.back() == L'\r') {
+    text.pop_back();
+  }
+
+  if (text.empty()) {
+    return new SString(DString(""));
+  }
+
+  if (tab2spaces && std::find(text.begin(), text.end(), L'\t') != text.end()) {
+    std::vector<wchar_t> expanded;
+    expanded.reserve(text.size() + cTabSize * 4);
+    for (auto it = text.begin(); it != text.end(); ++it) {
+      if (*it == L'\t') {
+        expanded.insert(expanded.end(), cTabSize - expanded.size() % cTabSize, L' ');
+      } else {
+        expanded.push_back(*it);
+      }
+    }
+    text.swap(expanded);
+  }
+  return new SString(DString(text.data(), 0, static_cast<int>(text.size())));
+}
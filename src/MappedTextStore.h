@@ -0,0 +1,106 @@
+#ifndef _MAPPEDTEXTSTORE_H_
+#define _MAPPEDTEXTSTORE_H_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <colorer/editor/BaseEditor.h>
+#include "pcolorer.h"
+#include "TextDecoder.h"
+
+// lines between the kept line offsets
+const size_t cLineIndexStep = 64;
+// decoded lines kept for the repeated requests
+const size_t cLineCacheSize = 16;
+
+/** Text lines of the file read through the file mapping.
+    Line starts are indexed by the background thread, only the
+    offset of every cLineIndexStep-th line is kept. A line is
+    decoded when it is requested, so the memory used doesn't
+    depend on the size of the file.
+    Encoding is detected by BOM, files without BOM are read
+    in ANSI code page. Lines are decoded by TextDecoder.
+    @ingroup far_plugin
+*/
+class MappedTextStore : public LineSource
+{
+public:
+  MappedTextStore();
+  ~MappedTextStore();
+
+  /** Maps the file and starts indexing of lines.
+      @throw Exception if the file can't be opened
+  */
+  void open(const String* fileName, bool tab2spaces);
+
+  /** Returns the line, or nullptr if it isn't indexed yet.
+      The line is valid for the next cLineCacheSize requests.
+  */
+  String* getLine(size_t lno);
+  void endJob(int lno) {};
+
+  /** Number of lines indexed so far */
+  size_t getLineCount() const
+  {
+    return lineCount;
+  }
+  /** true when the whole file is indexed */
+  bool isIndexed() const
+  {
+    return indexed;
+  }
+  /** Waits until the first lines are indexed */
+  void waitForLines(size_t count) const;
+  const String* getFileName() const
+  {
+    return fileName.get();
+  }
+
+private:
+  std::unique_ptr<SString> fileName;
+  bool tab2spaces;
+  HANDLE file;
+  HANDLE mapping;
+  unsigned __int64 fileSize;
+  /** the text starts after BOM */
+  unsigned __int64 textStart;
+  TextEncoding encoding;
+  /** bytes in the line feed of the encoding */
+  unsigned int unitSize;
+  DWORD granularity;
+
+  /** view of the last requested lines */
+  const char* view;
+  unsigned __int64 viewStart;
+  size_t viewSize;
+
+  /** offsets of the lines 0, cLineIndexStep, 2*cLineIndexStep... */
+  std::vector<unsigned __int64> lineIndex;
+  std::mutex indexLock;
+  std::atomic<size_t> lineCount;
+  std::atomic<bool> indexed;
+  std::atomic<bool> stop;
+  std::thread indexer;
+
+  /** start of the last requested line, the next lines are found from it */
+  size_t lastLine;
+  unsigned __int64 lastLineStart;
+
+  struct CachedLine {
+    size_t lno;
+    std::unique_ptr<SString> text;
+  };
+  std::vector<CachedLine> lineCache;
+  size_t nextCacheSlot;
+
+  void close();
+  void indexLines();
+  /** Maps the part of the file to the view, returns the pointer to offset or nullptr */
+  const char* mapView(unsigned __int64 offset, size_t size);
+  /** Returns position of the line feed ending the line, or the end of the file */
+  unsigned __int64 findLineEnd(unsigned __int64 lineStart);
+  SString* decode(unsigned __int64 start, unsigned __int64 end);
+};
+
+#endif
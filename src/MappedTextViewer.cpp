@@ -0,0 +1,167 @@
+#include <algorithm>
+#include "MappedTextViewer.h"
+
+// attributes of the status line
+const WORD cStatusColor = 0x30;
+
+MappedTextViewer::MappedTextViewer(BaseEditor* baseEditor_, MappedTextStore* textStore_, int background_) :
+  baseEditor(baseEditor_), textStore(textStore_), background(background_), screen(INVALID_HANDLE_VALUE),
+  width(0), height(0), topLine(0), leftColumn(0), lineCount(0)
+{
+}
+
+void MappedTextViewer::view()
+{
+  HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+  HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+  CONSOLE_SCREEN_BUFFER_INFO csbi;
+  if (!GetConsoleScreenBufferInfo(output, &csbi)) {
+    throw Exception(DString("Can't get console screen buffer info"));
+  }
+  screen = CreateConsoleScreenBuffer(GENERIC_READ | GENERIC_WRITE, 0, nullptr, CONSOLE_TEXTMODE_BUFFER, nullptr);
+  if (screen == INVALID_HANDLE_VALUE) {
+    throw Exception(DString("Can't create console screen buffer"));
+  }
+  width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+  height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+  COORD size = { static_cast<SHORT>(width), static_cast<SHORT>(height) };
+  SetConsoleScreenBufferSize(screen, size);
+  SetConsoleActiveScreenBuffer(screen);
+  buffer.resize(width * height);
+
+  bool run = true;
+  while (run) {
+    paint();
+    // while the file is indexed, the status line shows the line count growing
+    DWORD timeout = textStore->isIndexed() ? INFINITE : 200;
+    if (WaitForSingleObject(input, timeout) != WAIT_OBJECT_0) {
+      continue;
+    }
+    INPUT_RECORD ir;
+    DWORD read = 0;
+    if (!ReadConsoleInputW(input, &ir, 1, &read) || !read) {
+      break;
+    }
+    if (ir.EventType == KEY_EVENT && ir.Event.KeyEvent.bKeyDown) {
+      run = processKey(ir.Event.KeyEvent);
+    }
+  }
+
+  SetConsoleActiveScreenBuffer(output);
+  CloseHandle(screen);
+  screen = INVALID_HANDLE_VALUE;
+}
+
+void MappedTextViewer::paint()
+{
+  size_t count = textStore->getLineCount();
+  if (count != lineCount) {
+    lineCount = count;
+    baseEditor->lineCountEvent(static_cast<int>(lineCount));
+  }
+  int textHeight = height - 1;
+  baseEditor->visibleTextEvent(static_cast<int>(topLine), textHeight);
+
+  for (auto it = buffer.begin(); it != buffer.end(); ++it) {
+    it->Char.UnicodeChar = L' ';
+    it->Attributes = static_cast<WORD>(background);
+  }
+  paintStatus();
+
+  for (int y = 0; y < textHeight && topLine + y < lineCount; y++) {
+    size_t lno = topLine + y;
+    // regions first, parsing could request the other lines
+    LineRegion* l1 = baseEditor->getLineRegions(static_cast<int>(lno));
+    String* line = textStore->getLine(lno);
+    if (line == nullptr) {
+      continue;
+    }
+    CHAR_INFO* row = &buffer[(y + 1) * width];
+    int len = line->length();
+    for (int x = 0; x < width && leftColumn + x < len; x++) {
+      row[x].Char.UnicodeChar = (*line)[leftColumn + x];
+    }
+
+    for (; l1; l1 = l1->next) {
+      if (l1->special || l1->start == l1->end) {
+        continue;
+      }
+      const StyledRegion* rd = l1->styled();
+      if (rd == nullptr) {
+        continue;
+      }
+      int fore = rd->bfore ? rd->fore : (background & 0xF);
+      int back = rd->bback ? rd->back : ((background >> 4) & 0xF);
+      WORD attr = static_cast<WORD>(fore + (back << 4));
+      int end = l1->end == -1 ? leftColumn + width : l1->end;
+      for (int x = std::max<int>(l1->start - leftColumn, 0); x < end - leftColumn && x < width; x++) {
+        row[x].Attributes = attr;
+      }
+    }
+  }
+
+  COORD size = { static_cast<SHORT>(width), static_cast<SHORT>(height) };
+  COORD origin = { 0, 0 };
+  SMALL_RECT rect = { 0, 0, static_cast<SHORT>(width - 1), static_cast<SHORT>(height - 1) };
+  WriteConsoleOutputW(screen, buffer.data(), size, origin, &rect);
+}
+
+void MappedTextViewer::paintStatus()
+{
+  wchar_t status[512];
+  FileType* type = baseEditor->getFileType();
+  // '+' - the file is still being indexed
+  _snwprintf(status, 512, L" %s  %s  %Iu/%Iu%s  col %d", textStore->getFileName()->getWChars(),
+             type ? type->getDescription()->getWChars() : L"", topLine + 1, lineCount,
+             textStore->isIndexed() ? L"" : L"+", leftColumn + 1);
+  status[511] = 0;
+  for (int x = 0; x < width; x++) {
+    buffer[x].Attributes = cStatusColor;
+  }
+  for (int x = 0; x < width && status[x]; x++) {
+    buffer[x].Char.UnicodeChar = status[x];
+  }
+}
+
+bool MappedTextViewer::processKey(const KEY_EVENT_RECORD &key)
+{
+  size_t textHeight = height - 1;
+  size_t maxTop = lineCount > textHeight ? lineCount - textHeight : 0;
+  switch (key.wVirtualKeyCode) {
+    case VK_ESCAPE:
+    case VK_F10:
+      return false;
+    case VK_UP:
+      if (topLine > 0) {
+        topLine--;
+      }
+      break;
+    case VK_DOWN:
+      if (topLine < maxTop) {
+        topLine++;
+      }
+      break;
+    case VK_PRIOR:
+      topLine = topLine > textHeight ? topLine - textHeight : 0;
+      break;
+    case VK_NEXT:
+      topLine = std::min<size_t>(topLine + textHeight, maxTop);
+      break;
+    case VK_HOME:
+      topLine = 0;
+      leftColumn = 0;
+      break;
+    case VK_END:
+      topLine = maxTop;
+      break;
+    case VK_LEFT:
+      if (leftColumn > 0) {
+        leftColumn--;
+      }
+      break;
+    case VK_RIGHT:
+      leftColumn++;
+      break;
+  }
+  return true;
+}
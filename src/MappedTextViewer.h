@@ -0,0 +1,42 @@
+#ifndef _MAPPEDTEXTVIEWER_H_
+#define _MAPPEDTEXTVIEWER_H_
+
+#include <vector>
+#include <colorer/editor/BaseEditor.h>
+#include "MappedTextStore.h"
+
+/** Console viewer of the MappedTextStore text.
+    Works in its own screen buffer, the top line shows the file name,
+    the type and the position. Lines are requested only for the visible
+    part of the text, so the viewer starts before the file is indexed.
+    @ingroup far_plugin
+*/
+class MappedTextViewer
+{
+public:
+  MappedTextViewer(BaseEditor* baseEditor, MappedTextStore* textStore, int background);
+
+  /** Shows the text until Esc or F10 is pressed */
+  void view();
+
+private:
+  BaseEditor* baseEditor;
+  MappedTextStore* textStore;
+  int background;
+
+  HANDLE screen;
+  int width;
+  int height;
+  std::vector<CHAR_INFO> buffer;
+  size_t topLine;
+  int leftColumn;
+  /** line count passed to baseEditor */
+  size_t lineCount;
+
+  void paint();
+  void paintStatus();
+  /** @return false to close the viewer */
+  bool processKey(const KEY_EVENT_RECORD &key);
+};
+
+#endif
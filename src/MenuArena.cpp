@@ -0,0 +1,46 @@
+#include <cwchar>
+#include "MenuArena.h"
+
+MenuArena::MenuArena(size_t block_size) :
+  blockSize(block_size), current(0), used(0)
+{
+}
+
+wchar_t* MenuArena::alloc(size_t len)
+{
+  while (current < blocks.size() && blocks[current].size - used < len) {
+    current++;
+    used = 0;
+  }
+
+  if (current == blocks.size()) {
+    Block block;
+    block.size = len > blockSize ? len : blockSize;
+    block.data.reset(new wchar_t[block.size]);
+    blocks.push_back(std::move(block));
+    used = 0;
+  }
+
+  wchar_t* ptr = blocks[current].data.get() + used;
+  used += len;
+  return ptr;
+}
+
+const wchar_t* MenuArena::copy(const wchar_t* str, size_t len)
+{
+  wchar_t* ptr = alloc(len + 1);
+  wmemcpy(ptr, str, len);
+  ptr[len] = 0;
+  return ptr;
+}
+
+const wchar_t* MenuArena::copy(const wchar_t* str)
+{
+  return copy(str, wcslen(str));
+}
+
+void MenuArena::reset()
+{
+  current = 0;
+  used = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef _MENUARENA_H_
+#define _MENUARENA_H_
+
+#include <vector>
+#include <memory>
+
+/** Bump allocator for menu item labels.
+    Strings live until reset() or destruction of the arena.
+    reset() keeps allocated blocks, so rebuilding a menu
+    doesn't touch the heap.
+    @ingroup far_plugin
+*/
+class MenuArena
+{
+public:
+  MenuArena(size_t block_size = 16384);
+
+  /** Allocates buffer for len chars */
+  wchar_t* alloc(size_t len);
+  /** Copies string to the arena, adds zero at the end */
+  const wchar_t* copy(const wchar_t* str, size_t len);
+  const wchar_t* copy(const wchar_t* str);
+  /** Frees all strings */
+  void reset();
+
+private:
+  struct Block {
+    std::unique_ptr<wchar_t[]> data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks;
+  size_t blockSize;
+  size_t current;
+  size_t used;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "PairIndex.h"
+
+PairIndex::PairIndex(BaseEditor* baseEditor_, const Region* pairStart_, const Region* pairEnd_) :
+  baseEditor(baseEditor_), pairStart(pairStart_), pairEnd(pairEnd_), openTop(PairToken::npos), lineAccepted(false)
+{
+  baseEditor->addRegionHandler(this);
+  baseEditor->addEditorListener(this);
+}
+
+PairIndex::~PairIndex()
+{
+  baseEditor->removeRegionHandler(this);
+  baseEditor->removeEditorListener(this);
+}
+
+const PairToken* PairIndex::getToken(size_t lno, int pos) const
+{
+  if (lno >= lineFirst.size()) {
+    return nullptr;
+  }
+
+  size_t last = (lno + 1 < lineFirst.size()) ? lineFirst[lno + 1] : tokens.size();
+  const PairToken* found = nullptr;
+  // same as BaseEditor::getPairMatch - the last region under cursor wins
+  for (size_t idx = lineFirst[lno]; idx < last; idx++) {
+    if (pos >= tokens[idx].start && pos <= tokens[idx].end) {
+      found = &tokens[idx];
+    }
+  }
+  return found;
+}
+
+const PairToken* PairIndex::getPartner(const PairToken* token) const
+{
+  if (token == nullptr || token->partner == PairToken::npos) {
+    return nullptr;
+  }
+  return &tokens[token->partner];
+}
+
+LineRegion* PairIndex::getLineRegion(const PairToken* token) const
+{
+  // getLineRegions can parse text and move tokens
+  PairToken t = *token;
+  for (LineRegion* l1 = baseEditor->getLineRegions(static_cast<int>(t.lno)); l1; l1 = l1->next) {
+    if (l1->special || l1->region == nullptr) {
+      continue;
+    }
+    if (l1->start == t.start && l1->end == t.end &&
+        (l1->region->hasParent(pairStart) || l1->region->hasParent(pairEnd))) {
+      return l1;
+    }
+  }
+  return nullptr;
+}
+
+size_t PairIndex::getMemoryUsage() const
+{
+  return tokens.capacity() * sizeof(PairToken) + lineFirst.capacity() * sizeof(size_t) +
+         lineOpen.capacity() * sizeof(size_t);
+}
+
+void PairIndex::clearLine(size_t lno, String* line)
+{
+  // only continuous parsing from the top of the text gives correct balance.
+  // lines parsed again or parsed after a gap (backparse) are skipped.
+  lineAccepted = (lno == lineFirst.size());
+  if (lineAccepted) {
+    lineFirst.push_back(tokens.size());
+    lineOpen.push_back(openTop);
+  }
+}
+
+void PairIndex::addRegion(size_t lno, String* line, int sx, int ex, const Region* region)
+{
+  if (!lineAccepted || lno + 1 != lineFirst.size() || region == nullptr || ex == -1) {
+    return;
+  }
+
+  bool open = region->hasParent(pairStart);
+  if (!open && !region->hasParent(pairEnd)) {
+    return;
+  }
+
+  PairToken token = {lno, sx, ex, open, 0, PairToken::npos, openTop};
+  size_t idx = tokens.size();
+  if (open) {
+    token.depth = openTop == PairToken::npos ? 0 : tokens[openTop].depth + 1;
+    openTop = idx;
+  } else if (openTop != PairToken::npos) {
+    size_t pair = openTop;
+    openTop = tokens[pair].parent;
+    token.depth = tokens[pair].depth;
+    token.partner = pair;
+    token.parent = openTop;
+    tokens[pair].partner = idx;
+  }
+  tokens.push_back(token);
+}
+
+void PairIndex::modifyEvent(size_t topLine)
+{
+  if (topLine >= lineFirst.size()) {
+    return;
+  }
+
+  tokens.resize(lineFirst[topLine]);
+  openTop = lineOpen[topLine];
+  lineFirst.resize(topLine);
+  lineOpen.resize(topLine);
+  lineAccepted = false;
+
+  // only the pairs open at the start of the line can be closed in the dropped part of the text
+  for (size_t idx = openTop; idx != PairToken::npos; idx = tokens[idx].parent) {
+    tokens[idx].partner = PairToken::npos;
+  }
+}
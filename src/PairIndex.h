@@ -0,0 +1,79 @@
+#ifndef _PAIRINDEX_H_
+#define _PAIRINDEX_H_
+
+#include <vector>
+#include <colorer/editor/BaseEditor.h>
+
+/** One paired region (bracket, tag, keyword) found by the parser.
+*/
+struct PairToken
+{
+  size_t lno;
+  int start;
+  int end;
+  /** true for def:PairStart, false for def:PairEnd */
+  bool open;
+  /** Nesting level of the pair this token belongs to */
+  int depth;
+  /** Index of the matching token, or npos */
+  size_t partner;
+  /** Index of the pair start enclosing this token, or npos */
+  size_t parent;
+
+  static const size_t npos = SIZE_MAX;
+};
+
+/** Index of paired regions of the document.
+    Filled from parser events, it keeps a stack-based
+    match table of all pair starts/ends from the top of the
+    text to the last parsed line. Partner lookup doesn't need
+    to walk the region lists.
+    @ingroup far_plugin
+*/
+class PairIndex : public RegionHandler, public EditorListener
+{
+public:
+  PairIndex(BaseEditor* baseEditor, const Region* pairStart, const Region* pairEnd);
+  ~PairIndex();
+
+  /** Number of lines indexed from the start of the text */
+  size_t indexedLines() const
+  {
+    return lineFirst.size();
+  }
+
+  /** Returns pair token at the position, or nullptr.
+      Position should be in the indexed part of the text.
+  */
+  const PairToken* getToken(size_t lno, int pos) const;
+  /** Returns matched token for the token, or nullptr if pair is not closed yet */
+  const PairToken* getPartner(const PairToken* token) const;
+  /** Returns region of the token from the editor line regions, or nullptr */
+  LineRegion* getLineRegion(const PairToken* token) const;
+  /** Size of the index in bytes */
+  size_t getMemoryUsage() const;
+
+  void clearLine(size_t lno, String* line);
+  void addRegion(size_t lno, String* line, int sx, int ex, const Region* region);
+  void enterScheme(size_t lno, String* line, int sx, int ex, const Region* region, const Scheme* scheme) {};
+  void leaveScheme(size_t lno, String* line, int sx, int ex, const Region* region, const Scheme* scheme) {};
+
+  void modifyEvent(size_t topLine);
+
+private:
+  BaseEditor* baseEditor;
+  const Region* pairStart;
+  const Region* pairEnd;
+
+  std::vector<PairToken> tokens;
+  /** index of the first token of each indexed line */
+  std::vector<size_t> lineFirst;
+  /** innermost not closed pair start at the start of each indexed line */
+  std::vector<size_t> lineOpen;
+  /** innermost not closed pair start, the others are linked by parent */
+  size_t openTop;
+  /** the last line passed by parser is appended to the index */
+  bool lineAccepted;
+};
+
+#endif
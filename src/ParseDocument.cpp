@@ -0,0 +1,112 @@
+#include <algorithm>
+#include "ParseDocument.h"
+
+ParseDocument::ParseDocument(ParserFactory* pf) :
+  regionIndex(nullptr), parserFactory(pf), generation(0), regionCount(0)
+{
+  fileState.size = 0;
+  fileState.time = 0;
+  fileState.contentHash = 0;
+
+  DString def_out = DString("def:Outlined");
+  DString def_err = DString("def:Error");
+  baseEditor = new BaseEditor(parserFactory, this);
+  const Region* def_Outlined = parserFactory->getHRCParser()->getRegion(&def_out);
+  const Region* def_Error = parserFactory->getHRCParser()->getRegion(&def_err);
+  structOutliner = new Outliner(baseEditor, def_Outlined);
+  errorOutliner = new Outliner(baseEditor, def_Error);
+
+  DString def_pair_start = DString("def:PairStart");
+  DString def_pair_end = DString("def:PairEnd");
+  const Region* def_PairStart = parserFactory->getHRCParser()->getRegion(&def_pair_start);
+  const Region* def_PairEnd = parserFactory->getHRCParser()->getRegion(&def_pair_end);
+  pairIndex = new PairIndex(baseEditor, def_PairStart, def_PairEnd);
+  baseEditor->addRegionHandler(this);
+}
+
+ParseDocument::~ParseDocument()
+{
+  baseEditor->removeRegionHandler(this);
+  delete regionIndex;
+  delete structOutliner;
+  delete errorOutliner;
+  delete pairIndex;
+  delete baseEditor;
+}
+
+String* ParseDocument::getLine(size_t lno)
+{
+  return views.front()->getLine(lno);
+}
+
+void ParseDocument::endJob(int lno)
+{
+  views.front()->endJob(lno);
+}
+
+void ParseDocument::attach(LineSource* view)
+{
+  views.push_back(view);
+}
+
+void ParseDocument::detach(LineSource* view)
+{
+  auto it = std::find(views.begin(), views.end(), view);
+  if (it != views.end()) {
+    views.erase(it);
+  }
+}
+
+void ParseDocument::clearLine(size_t lno, String* line)
+{
+  if (lno >= lineRegions.size()) {
+    lineRegions.resize(lno + 1, 0);
+  }
+  regionCount -= lineRegions[lno];
+  lineRegions[lno] = 0;
+}
+
+void ParseDocument::addRegion(size_t lno, String* line, int sx, int ex, const Region* region)
+{
+  countRegion(lno);
+}
+
+void ParseDocument::enterScheme(size_t lno, String* line, int sx, int ex, const Region* region, const Scheme* scheme)
+{
+  countRegion(lno);
+}
+
+void ParseDocument::leaveScheme(size_t lno, String* line, int sx, int ex, const Region* region, const Scheme* scheme)
+{
+  countRegion(lno);
+}
+
+void ParseDocument::countRegion(size_t lno)
+{
+  if (lno >= lineRegions.size()) {
+    lineRegions.resize(lno + 1, 0);
+  }
+  lineRegions[lno]++;
+  regionCount++;
+}
+
+size_t ParseDocument::getMemoryUsage()
+{
+  // region lists of BaseEditor and its slot for each parsed line
+  size_t usage = regionCount * sizeof(LineRegion) + lineRegions.size() * sizeof(LineRegion*);
+  usage += lineRegions.capacity() * sizeof(unsigned int);
+  usage += (structOutliner->itemCount() + errorOutliner->itemCount()) * sizeof(OutlineItem);
+  usage += pairIndex->getMemoryUsage();
+  if (regionIndex != nullptr) {
+    usage += regionIndex->getMemoryUsage();
+  }
+  return usage;
+}
+
+RegionIndex* ParseDocument::getRegionIndex()
+{
+  if (regionIndex == nullptr) {
+    regionIndex = new RegionIndex(parserFactory, baseEditor, this);
+  }
+  return regionIndex;
+}
@@ -0,0 +1,94 @@
+#ifndef _PARSEDOCUMENT_H_
+#define _PARSEDOCUMENT_H_
+
+#include <vector>
+#include <colorer/editor/BaseEditor.h>
+#include <colorer/editor/Outliner.h>
+#include "PairIndex.h"
+#include "RegionIndex.h"
+
+/** Parse state of a text: BaseEditor with its outliners and pair index.
+    The region search index is created on the first search.
+    One document is shared by the editors of the same file while
+    their text is the same as it was loaded. BaseEditor reads the
+    lines through the document from the first attached editor.
+    Regions stored by BaseEditor are counted for memory accounting.
+    @ingroup far_plugin
+*/
+class ParseDocument : public LineSource, public RegionHandler
+{
+public:
+  ParseDocument(ParserFactory* pf);
+  ~ParseDocument();
+
+  String* getLine(size_t lno);
+  void endJob(int lno);
+
+  void clearLine(size_t lno, String* line);
+  void addRegion(size_t lno, String* line, int sx, int ex, const Region* region);
+  void enterScheme(size_t lno, String* line, int sx, int ex, const Region* region, const Scheme* scheme);
+  void leaveScheme(size_t lno, String* line, int sx, int ex, const Region* region, const Scheme* scheme);
+
+  /** Estimated size of the parse state in bytes */
+  size_t getMemoryUsage();
+
+  /** Adds editor of the text. */
+  void attach(LineSource* view);
+  /** Removes editor, the next one becomes the source of lines. */
+  void detach(LineSource* view);
+  size_t viewCount() const
+  {
+    return views.size();
+  }
+
+  /** Marks the text as changed, so new editors of the file don't share it. */
+  void changed()
+  {
+    generation++;
+  }
+  /** Number of changes since the text was loaded, 0 - the text can be shared. */
+  size_t getGeneration() const
+  {
+    return generation;
+  }
+
+  ParserFactory* getParserFactory() const
+  {
+    return parserFactory;
+  }
+
+  /** State of the file when the text was loaded, to check it on reopen */
+  struct FileState {
+    unsigned __int64 size;
+    unsigned __int64 time;
+    unsigned int contentHash;
+
+    bool equals(const FileState &other) const
+    {
+      return size == other.size && time == other.time && contentHash == other.contentHash;
+    }
+  };
+  FileState fileState;
+
+  BaseEditor* baseEditor;
+  Outliner* structOutliner;
+  Outliner* errorOutliner;
+  PairIndex* pairIndex;
+
+  /** Index of the searched region, it is created on the first call */
+  RegionIndex* getRegionIndex();
+
+private:
+  RegionIndex* regionIndex;
+  ParserFactory* parserFactory;
+  std::vector<LineSource*> views;
+  size_t generation;
+
+  /** number of stored regions of each parsed line */
+  std::vector<unsigned int> lineRegions;
+  size_t regionCount;
+
+  void countRegion(size_t lno);
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "PhaseProfiler.h"
+#include <psapi.h>
+
+PhaseProfiler::Phase::Phase(PhaseProfiler* profiler_, const wchar_t* name_) :
+  profiler(profiler_), name(name_), start(std::chrono::steady_clock::now()), memory(getMemoryUsage())
+{
+}
+
+PhaseProfiler::Phase::~Phase()
+{
+  double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  profiler->add(name, time, getMemoryUsage() - memory);
+}
+
+void PhaseProfiler::clear()
+{
+  records.clear();
+}
+
+void PhaseProfiler::add(const wchar_t* name, double time, __int64 memoryDelta)
+{
+  Record rec = {name, time, memoryDelta};
+  records.push_back(rec);
+}
+
+void PhaseProfiler::getReport(StringBuffer &report) const
+{
+  wchar_t line[128];
+  double total_time = 0;
+  __int64 total_memory = 0;
+  for (auto it = records.begin(); it != records.end(); ++it) {
+    _snwprintf(line, 128, L"%-20s %10.1f ms %+10lld KB\n", it->name, it->time, it->memory / 1024);
+    line[127] = 0;
+    report.append(DString(line));
+    total_time += it->time;
+    total_memory += it->memory;
+  }
+  _snwprintf(line, 128, L"%-20s %10.1f ms %+10lld KB\n", L"total", total_time, total_memory / 1024);
+  line[127] = 0;
+  report.append(DString(line));
+}
+
+void PhaseProfiler::writeReport(colorer::ErrorHandler* eh) const
+{
+  if (eh == nullptr) {
+    return;
+  }
+  StringBuffer report;
+  getReport(report);
+  int start = 0;
+  for (int i = 0; i < report.length(); i++) {
+    if (report[i] == '\n') {
+      StringBuffer line("profile: ");
+      line.append(DString(report.getWChars(), start, i - start));
+      eh->warning(line);
+      start = i + 1;
+    }
+  }
+}
+
+__int64 PhaseProfiler::getMemoryUsage()
+{
+  PROCESS_MEMORY_COUNTERS_EX pmc;
+  pmc.cb = sizeof(pmc);
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc), sizeof(pmc))) {
+    return 0;
+  }
+  return static_cast<__int64>(pmc.PrivateUsage);
+}
@@ -0,0 +1,49 @@
+#ifndef _PHASEPROFILER_H_
+#define _PHASEPROFILER_H_
+
+#include <chrono>
+#include <vector>
+#include <colorer/handlers/FileErrorHandler.h>
+#include "pcolorer.h"
+
+/** Time and memory usage of the startup and reload phases.
+    Memory is the private bytes of the process, so a phase
+    delta includes allocations of all threads.
+    @ingroup far_plugin
+*/
+class PhaseProfiler
+{
+public:
+  /** Measures the phase from creation to destruction */
+  class Phase
+  {
+  public:
+    Phase(PhaseProfiler* profiler, const wchar_t* name);
+    ~Phase();
+  private:
+    PhaseProfiler* profiler;
+    const wchar_t* name;
+    std::chrono::steady_clock::time_point start;
+    __int64 memory;
+  };
+
+  void clear();
+  /** @param name static string */
+  void add(const wchar_t* name, double time, __int64 memoryDelta);
+  /** Appends report, one line per phase and the total line */
+  void getReport(StringBuffer &report) const;
+  /** Writes report to the log, one message per line */
+  void writeReport(colorer::ErrorHandler* eh) const;
+
+  static __int64 getMemoryUsage();
+
+private:
+  struct Record {
+    const wchar_t* name;
+    double time;
+    __int64 memory;
+  };
+  std::vector<Record> records;
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "RegionGrep.h"
+#include "BaseLoader.h"
+#include <colorer/ParserFactoryException.h>
+#include <colorer/viewer/TextLinesStore.h>
+
+RegionGrep::RegionGrep(const String* catalogPath_, const String* userHrcPath_, const wchar_t* pattern, bool ignoreCase,
+                       const std::vector<std::wstring> &inRegions_, const std::vector<std::wstring> &notRegions_, colorer::ErrorHandler* eh) :
+  catalogPath(nullptr), userHrcPath(nullptr), inRegions(inRegions_), notRegions(notRegions_), errorHandler(eh), syncErrorHandler(eh),
+  nextFile(0), doneCount(0), failedCount(0), matchCount(0), finishedWorkers(0), stop(false), error(nullptr)
+{
+  if (catalogPath_) {
+    catalogPath.reset(new SString(*catalogPath_));
+  }
+  if (userHrcPath_ && userHrcPath_->length()) {
+    userHrcPath.reset(new SString(*userHrcPath_));
+  }
+  try {
+    auto flags = std::regex_constants::ECMAScript | std::regex_constants::optimize;
+    if (ignoreCase) {
+      flags |= std::regex_constants::icase;
+    }
+    expression.assign(pattern, flags);
+  } catch (std::regex_error &) {
+    StringBuffer msg("Wrong regular expression: ");
+    msg.append(DString(pattern));
+    throw Exception(msg);
+  }
+}
+
+RegionGrep::~RegionGrep()
+{
+  stop = true;
+  join();
+}
+
+void RegionGrep::add(const String &fileName)
+{
+  files.push_back(std::unique_ptr<SString>(new SString(fileName)));
+}
+
+void RegionGrep::start(size_t threads)
+{
+  if (threads > files.size()) {
+    threads = files.size();
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back(&RegionGrep::worker, this);
+  }
+}
+
+bool RegionGrep::wait(unsigned int timeout_ms)
+{
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (finishedWorkers < workers.size()) {
+    if (std::chrono::steady_clock::now() >= end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  join();
+  return true;
+}
+
+void RegionGrep::join()
+{
+  for (auto it = workers.begin(); it != workers.end(); ++it) {
+    if (it->joinable()) {
+      it->join();
+    }
+  }
+}
+
+void RegionGrep::setError(const String* msg)
+{
+  std::lock_guard<std::mutex> guard(errorLock);
+  if (error == nullptr) {
+    error.reset(new SString(*msg));
+  }
+}
+
+void RegionGrep::takeMatches(std::vector<Match> &list)
+{
+  std::lock_guard<std::mutex> guard(matchLock);
+  for (auto it = found.begin(); it != found.end(); ++it) {
+    list.push_back(std::move(*it));
+  }
+  found.clear();
+}
+
+/** Regions of the names, in the HRC database of the thread */
+static void getRegions(HRCParser* hrcParser, const std::vector<std::wstring> &names, std::vector<const Region*> &regions)
+{
+  for (auto it = names.begin(); it != names.end(); ++it) {
+    DString name(it->c_str());
+    const Region* region = hrcParser->getRegion(&name);
+    if (region == nullptr) {
+      StringBuffer msg("Unknown region: ");
+      msg.append(name);
+      throw Exception(msg);
+    }
+    regions.push_back(region);
+  }
+}
+
+void RegionGrep::worker()
+{
+  try {
+    ParserFactory pf(errorHandler ? &syncErrorHandler : nullptr);
+    loadBase(&pf, catalogPath.get(), userHrcPath.get());
+    HRCParser* hrcParser = pf.getHRCParser();
+    std::vector<const Region*> inside;
+    std::vector<const Region*> outside;
+    getRegions(hrcParser, inRegions, inside);
+    getRegions(hrcParser, notRegions, outside);
+
+    // BaseEditor keeps regions only with a mapper
+    DString hrdClass = DString("console");
+    std::unique_ptr<RegionMapper> mapper(pf.createStyledMapper(&hrdClass, nullptr));
+
+    while (!stop) {
+      size_t idx = nextFile++;
+      if (idx >= files.size()) {
+        break;
+      }
+      try {
+        grep(&pf, mapper.get(), inside, outside, idx);
+      } catch (Exception &e) {
+        StringBuffer msg(files[idx].get());
+        msg.append(DString(": ")).append(e.getMessage());
+        setError(&msg);
+        failedCount++;
+      } catch (std::exception &e) {
+        // std::regex throws on too complex matches of a long line
+        StringBuffer msg(files[idx].get());
+        msg.append(DString(": ")).append(DString(e.what()));
+        setError(&msg);
+        failedCount++;
+      }
+      doneCount++;
+    }
+  } catch (Exception &e) {
+    setError(e.getMessage());
+    stop = true;
+  } catch (std::exception &e) {
+    DString msg(e.what());
+    setError(&msg);
+    stop = true;
+  }
+  finishedWorkers++;
+}
+
+/** Checks the regions at the position: inside one of the first list and outside of the second */
+static bool matchRegions(LineRegion* lineRegions, int pos, const std::vector<const Region*> &inside,
+                         const std::vector<const Region*> &outside)
+{
+  bool in = inside.empty();
+  for (LineRegion* l1 = lineRegions; l1; l1 = l1->next) {
+    if (l1->special || l1->region == nullptr) {
+      continue;
+    }
+    if (pos < l1->start || (l1->end != -1 && pos >= l1->end)) {
+      continue;
+    }
+    for (auto it = outside.begin(); it != outside.end(); ++it) {
+      if (l1->region->hasParent(*it)) {
+        return false;
+      }
+    }
+    for (auto it = inside.begin(); !in && it != inside.end(); ++it) {
+      in = l1->region->hasParent(*it);
+    }
+  }
+  return in;
+}
+
+void RegionGrep::grep(ParserFactory* pf, RegionMapper* mapper, const std::vector<const Region*> &inside,
+                      const std::vector<const Region*> &outside, size_t file)
+{
+  TextLinesStore textLinesStore;
+  // the raw text: the positions are the editor columns, and the expression can match tabs
+  textLinesStore.loadFile(files[file].get(), nullptr, false);
+  size_t lines = textLinesStore.getLineCount();
+
+  // only the lines with the expression need the regions
+  std::vector<size_t> candidates;
+  std::vector<std::wstring> texts;
+  std::wstring text;
+  for (size_t lno = 0; lno < lines && !stop; lno++) {
+    String* line = textLinesStore.getLine(lno);
+    int len = line ? line->length() : 0;
+    text.resize(len);
+    for (int i = 0; i < len; i++) {
+      text[i] = (*line)[i];
+    }
+    if (std::regex_search(text, expression)) {
+      candidates.push_back(lno);
+      texts.push_back(text);
+    }
+  }
+  if (candidates.empty() || stop) {
+    return;
+  }
+
+  BaseEditor baseEditor(pf, &textLinesStore);
+  baseEditor.setRegionMapper(mapper);
+  baseEditor.chooseFileType(files[file].get());
+  baseEditor.lineCountEvent(static_cast<int>(lines));
+
+  std::vector<Match> list;
+  for (size_t idx = 0; idx < candidates.size() && !stop; idx++) {
+    LineRegion* lineRegions = baseEditor.getLineRegions(static_cast<int>(candidates[idx]));
+    const std::wstring &line = texts[idx];
+    for (std::wsregex_iterator it(line.begin(), line.end(), expression), end; it != end; ++it) {
+      int pos = static_cast<int>(it->position());
+      if (!matchRegions(lineRegions, pos, inside, outside)) {
+        continue;
+      }
+      Match match = { file, candidates[idx], pos, static_cast<int>(it->length()), line.substr(0, cMatchLineMax) };
+      list.push_back(std::move(match));
+    }
+  }
+  if (list.empty()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(matchLock);
+  matchCount += list.size();
+  for (auto it = list.begin(); it != list.end(); ++it) {
+    found.push_back(std::move(*it));
+  }
+}
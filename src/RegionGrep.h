@@ -0,0 +1,115 @@
+#ifndef _REGIONGREP_H_
+#define _REGIONGREP_H_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <colorer/ParserFactory.h>
+#include <colorer/editor/BaseEditor.h>
+#include "pcolorer.h"
+#include "SyncErrorHandler.h"
+
+/** Searches files for a regular expression, only in the given regions.
+    Each thread has its own ParserFactory, as HRCParser is not thread
+    safe, and takes the next file from the shared list. A file is parsed
+    only if the expression is found in its text, up to the last line found.
+    Matches are collected as the files are done and can be taken during
+    the search.
+    @ingroup far_plugin
+*/
+class RegionGrep
+{
+public:
+  struct Match {
+    /** index of the file */
+    size_t file;
+    size_t lno;
+    int pos;
+    int length;
+    /** the line, cut to cMatchLineMax characters */
+    std::wstring line;
+  };
+
+  /** @param inRegions the match should be inside one of these regions or their descendants,
+             all regions if it is empty
+      @param notRegions the match should be outside of these regions
+      @throw Exception if the expression is wrong
+  */
+  RegionGrep(const String* catalogPath, const String* userHrcPath, const wchar_t* pattern, bool ignoreCase,
+             const std::vector<std::wstring> &inRegions, const std::vector<std::wstring> &notRegions, colorer::ErrorHandler* eh);
+  /** Stops search and waits for the threads */
+  ~RegionGrep();
+
+  void add(const String &fileName);
+  void start(size_t threads);
+  /** Waits for the end of search.
+      @return false if it isn't finished after timeout
+  */
+  bool wait(unsigned int timeout_ms);
+
+  size_t count() const
+  {
+    return files.size();
+  }
+  size_t done() const
+  {
+    return doneCount;
+  }
+  size_t failed() const
+  {
+    return failedCount;
+  }
+  /** Number of matches found, including not taken ones */
+  size_t matches() const
+  {
+    return matchCount;
+  }
+  const String* getFileName(size_t file) const
+  {
+    return files[file].get();
+  }
+  /** Moves the matches found since the last call to the end of the list */
+  void takeMatches(std::vector<Match> &list);
+  /** The first error, or nullptr */
+  const String* getError() const
+  {
+    return error.get();
+  }
+
+  static const int cMatchLineMax = 256;
+
+private:
+  std::unique_ptr<SString> catalogPath;
+  std::unique_ptr<SString> userHrcPath;
+  std::wregex expression;
+  std::vector<std::wstring> inRegions;
+  std::vector<std::wstring> notRegions;
+  colorer::ErrorHandler* errorHandler;
+  SyncErrorHandler syncErrorHandler;
+
+  std::vector<std::unique_ptr<SString>> files;
+  std::vector<std::thread> workers;
+  std::atomic<size_t> nextFile;
+  std::atomic<size_t> doneCount;
+  std::atomic<size_t> failedCount;
+  std::atomic<size_t> matchCount;
+  std::atomic<size_t> finishedWorkers;
+  std::atomic<bool> stop;
+  std::mutex matchLock;
+  std::vector<Match> found;
+  std::mutex errorLock;
+  std::unique_ptr<SString> error;
+
+  void worker();
+  void join();
+  void setError(const String* msg);
+  /** Searches one file, the regions are of the thread's HRCParser */
+  void grep(ParserFactory* pf, RegionMapper* mapper, const std::vector<const Region*> &inside,
+            const std::vector<const Region*> &outside, size_t file);
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <chrono>
+#include "RegionIndex.h"
+
+/** number of lines parsed between the checks of time */
+const size_t cParseStep = 1000;
+
+RegionIndex::RegionIndex(ParserFactory* pf, BaseEditor* documentEditor_, LineSource* lineSource) :
+  parserFactory(pf), documentEditor(documentEditor_), region(nullptr), openMatches(0), lineAccepted(false)
+{
+  baseEditor = new BaseEditor(parserFactory, lineSource);
+  baseEditor->addRegionHandler(this);
+  documentEditor->addEditorListener(this);
+}
+
+RegionIndex::~RegionIndex()
+{
+  documentEditor->removeEditorListener(this);
+  baseEditor->removeRegionHandler(this);
+  delete baseEditor;
+}
+
+bool RegionIndex::setRegion(const String* regionName)
+{
+  const Region* r = parserFactory->getHRCParser()->getRegion(regionName);
+  if (r == nullptr) {
+    return false;
+  }
+  if (r != region) {
+    region = r;
+    clear(0);
+  }
+  return true;
+}
+
+RegionIndex::SearchResult RegionIndex::find(size_t lno, int pos, bool forward, size_t lineCount, int timeSlice, Occurrence &result)
+{
+  if (region == nullptr) {
+    return SR_NOT_FOUND;
+  }
+  FileType* ftype = documentEditor->getFileType();
+  if (baseEditor->getFileType() != ftype) {
+    baseEditor->setFileType(ftype);
+    clear(0);
+  }
+  baseEditor->lineCountEvent(static_cast<int>(lineCount));
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeSlice);
+  while (true) {
+    // lines are complete between the parser calls.
+    // backward search needs the whole cursor line.
+    if (forward || indexedLines() > lno) {
+      if (findIndexed(lno, pos, forward, result)) {
+        return SR_FOUND;
+      }
+      if (!forward) {
+        return SR_NOT_FOUND;
+      }
+    }
+    if (indexedLines() >= lineCount) {
+      return SR_NOT_FOUND;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return SR_TIMEOUT;
+    }
+
+    size_t lines = indexedLines();
+    baseEditor->validate(static_cast<int>(std::min<size_t>(lines + cParseStep, lineCount) - 1), false);
+    if (indexedLines() == lines) {
+      // parser doesn't go further
+      return SR_NOT_FOUND;
+    }
+  }
+}
+
+bool RegionIndex::findIndexed(size_t lno, int pos, bool forward, Occurrence &result) const
+{
+  // occurrences are in the order of lines, but not of positions in the line
+  auto less_line = [](const Occurrence & item, size_t line) {
+    return item.lno < line;
+  };
+  const Occurrence* found = nullptr;
+  if (forward) {
+    auto it = std::lower_bound(items.begin(), items.end(), lno, less_line);
+    for (; it != items.end(); ++it) {
+      if (found != nullptr && it->lno != found->lno) {
+        break;
+      }
+      if ((it->lno > lno || it->start > pos) && (found == nullptr || it->start < found->start)) {
+        found = &*it;
+      }
+    }
+  } else {
+    auto it = std::lower_bound(items.begin(), items.end(), lno + 1, less_line);
+    while (it != items.begin()) {
+      --it;
+      if (found != nullptr && it->lno != found->lno) {
+        break;
+      }
+      if ((it->lno < lno || it->start < pos) && (found == nullptr || it->start > found->start)) {
+        found = &*it;
+      }
+    }
+  }
+  if (found == nullptr) {
+    return false;
+  }
+  result = *found;
+  return true;
+}
+
+size_t RegionIndex::getMemoryUsage() const
+{
+  return items.capacity() * sizeof(Occurrence) + lineDepth.capacity() * sizeof(int) + schemeStack.capacity() * sizeof(size_t);
+}
+
+bool RegionIndex::matches(const Region* r) const
+{
+  return r != nullptr && r->hasParent(region);
+}
+
+void RegionIndex::clearLine(size_t lno, String* line)
+{
+  // only continuous parsing from the top of the text gives correct scheme nesting
+  lineAccepted = (lno == lineDepth.size());
+  if (lineAccepted) {
+    lineDepth.push_back(static_cast<int>(schemeStack.size()));
+  }
+}
+
+void RegionIndex::addRegion(size_t lno, String* line, int sx, int ex, const Region* r)
+{
+  if (!lineAccepted || openMatches || !matches(r)) {
+    return;
+  }
+  Occurrence item = {lno, sx, ex};
+  items.push_back(item);
+}
+
+void RegionIndex::enterScheme(size_t lno, String* line, int sx, int ex, const Region* r, const Scheme* scheme)
+{
+  if (!lineAccepted) {
+    return;
+  }
+  if (!openMatches && matches(r)) {
+    Occurrence item = {lno, sx, -1};
+    items.push_back(item);
+    schemeStack.push_back(items.size() - 1);
+    openMatches++;
+  } else {
+    schemeStack.push_back(npos);
+  }
+}
+
+void RegionIndex::leaveScheme(size_t lno, String* line, int sx, int ex, const Region* r, const Scheme* scheme)
+{
+  if (!lineAccepted || schemeStack.empty()) {
+    return;
+  }
+  size_t idx = schemeStack.back();
+  schemeStack.pop_back();
+  if (idx != npos) {
+    openMatches--;
+    if (items[idx].lno == lno) {
+      items[idx].end = ex;
+    }
+  }
+}
+
+void RegionIndex::modifyEvent(size_t topLine)
+{
+  if (topLine < lineDepth.size()) {
+    clear(topLine);
+  }
+}
+
+void RegionIndex::clear(size_t topLine)
+{
+  // the index is cut at the line out of any scheme, its nesting is known
+  size_t lines = topLine;
+  if (lines >= lineDepth.size()) {
+    lines = lineDepth.empty() ? 0 : lineDepth.size() - 1;
+  }
+  while (lines > 0 && lineDepth[lines] != 0) {
+    lines--;
+  }
+  auto it = std::lower_bound(items.begin(), items.end(), lines, [](const Occurrence & item, size_t line) {
+    return item.lno < line;
+  });
+  items.erase(it, items.end());
+  lineDepth.resize(lines);
+  schemeStack.clear();
+  openMatches = 0;
+  lineAccepted = false;
+  baseEditor->modifyEvent(static_cast<int>(lines));
+}
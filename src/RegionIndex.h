@@ -0,0 +1,88 @@
+#ifndef _REGIONINDEX_H_
+#define _REGIONINDEX_H_
+
+#include <vector>
+#include <colorer/editor/BaseEditor.h>
+
+/** Occurrences of one region and its descendants in the text.
+    The text is parsed from the top by the own BaseEditor, so the
+    search for a new region doesn't change the parse state of the
+    editor. The index is extended lazily, in time slices, only
+    as far as the search needs. Occurrences nested in a found
+    scheme are skipped.
+    @ingroup far_plugin
+*/
+class RegionIndex : public RegionHandler, public EditorListener
+{
+public:
+  /** @param documentEditor the editor of the document, its file type is used
+             and its text changes are followed
+  */
+  RegionIndex(ParserFactory* pf, BaseEditor* documentEditor, LineSource* lineSource);
+  ~RegionIndex();
+
+  struct Occurrence {
+    size_t lno;
+    int start;
+    /** end on the start line, -1 - up to the end of the line */
+    int end;
+  };
+
+  enum SearchResult { SR_FOUND, SR_NOT_FOUND, SR_TIMEOUT };
+
+  /** Starts the index of the region, the index of the same region is kept.
+      @return false if there is no such region
+  */
+  bool setRegion(const String* regionName);
+  const Region* getRegion() const
+  {
+    return region;
+  }
+
+  /** Finds the nearest occurrence after the position or before it.
+      Text is parsed until the occurrence is found or the time is over,
+      the next call continues parsing.
+      @param timeSlice time of parsing in milliseconds
+  */
+  SearchResult find(size_t lno, int pos, bool forward, size_t lineCount, int timeSlice, Occurrence &result);
+
+  /** Number of lines indexed from the start of the text */
+  size_t indexedLines() const
+  {
+    return lineDepth.size();
+  }
+  /** Size of the index in bytes */
+  size_t getMemoryUsage() const;
+
+  void clearLine(size_t lno, String* line);
+  void addRegion(size_t lno, String* line, int sx, int ex, const Region* region);
+  void enterScheme(size_t lno, String* line, int sx, int ex, const Region* region, const Scheme* scheme);
+  void leaveScheme(size_t lno, String* line, int sx, int ex, const Region* region, const Scheme* scheme);
+
+  void modifyEvent(size_t topLine);
+
+private:
+  ParserFactory* parserFactory;
+  BaseEditor* documentEditor;
+  BaseEditor* baseEditor;
+  const Region* region;
+
+  std::vector<Occurrence> items;
+  /** scheme nesting depth at the start of each indexed line */
+  std::vector<int> lineDepth;
+  /** entered schemes: index of the occurrence or npos */
+  std::vector<size_t> schemeStack;
+  /** number of found schemes in the stack */
+  size_t openMatches;
+  /** the last line passed by parser is appended to the index */
+  bool lineAccepted;
+
+  static const size_t npos = SIZE_MAX;
+
+  void clear(size_t topLine);
+  bool matches(const Region* r) const;
+  /** Searches in the indexed part of the text */
+  bool findIndexed(size_t lno, int pos, bool forward, Occurrence &result) const;
+};
+
+#endif
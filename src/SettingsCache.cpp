@@ -0,0 +1,202 @@
+#include "SettingsCache.h"
+
+SettingsCache::SettingsCache() : loaded(false)
+{
+  root.parent = nullptr;
+  root.changed = false;
+}
+
+SettingsCache::Key* SettingsCache::toKey(size_t Root)
+{
+  if (!loaded) {
+    load();
+  }
+  return Root ? reinterpret_cast<Key*>(Root) : &root;
+}
+
+void SettingsCache::load()
+{
+  SettingsControl settings;
+  readKey(settings, 0, &root);
+  loaded = true;
+}
+
+void SettingsCache::readKey(SettingsControl &settings, size_t farKey, Key* key)
+{
+  FarSettingsEnum fse;
+  fse.StructSize = sizeof(FarSettingsEnum);
+  if (!settings.rEnum(farKey, &fse)) {
+    return;
+  }
+  for (size_t i = 0; i < fse.Count; i++) {
+    const wchar_t* name = fse.Items[i].Name;
+    switch (fse.Items[i].Type) {
+      case FST_SUBKEY: {
+        size_t far_subkey = settings.rOpenSubKey(farKey, name);
+        if (far_subkey) {
+          Key* subkey = new Key();
+          subkey->parent = key;
+          subkey->name = name;
+          subkey->changed = false;
+          key->subkeys[name].reset(subkey);
+          readKey(settings, far_subkey, subkey);
+        }
+        break;
+      }
+      case FST_STRING: {
+        Value &value = key->values[name];
+        value.type = FST_STRING;
+        value.string = settings.Get(farKey, name, L"");
+        value.number = 0;
+        value.changed = false;
+        break;
+      }
+      case FST_QWORD: {
+        Value &value = key->values[name];
+        value.type = FST_QWORD;
+        value.number = settings.Get(farKey, name, 0ull);
+        value.changed = false;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+const wchar_t* SettingsCache::Get(size_t Root, const wchar_t* Name, const wchar_t* Default)
+{
+  Key* key = toKey(Root);
+  auto it = key->values.find(Name);
+  if (it != key->values.end() && it->second.type == FST_STRING) {
+    return it->second.string.c_str();
+  }
+  return Default;
+}
+
+unsigned __int64 SettingsCache::Get(size_t Root, const wchar_t* Name, unsigned __int64 Default)
+{
+  Key* key = toKey(Root);
+  auto it = key->values.find(Name);
+  if (it != key->values.end() && it->second.type == FST_QWORD) {
+    return it->second.number;
+  }
+  return Default;
+}
+
+SettingsCache::Value* SettingsCache::setValue(size_t Root, const wchar_t* Name, FARSETTINGSTYPES type)
+{
+  Key* key = toKey(Root);
+  auto it = key->values.find(Name);
+  if (it == key->values.end()) {
+    it = key->values.insert(std::make_pair(std::wstring(Name), Value())).first;
+    it->second.number = 0;
+  }
+  it->second.type = type;
+  it->second.changed = true;
+  for (; key != nullptr && !key->changed; key = key->parent) {
+    key->changed = true;
+  }
+  return &it->second;
+}
+
+void SettingsCache::Set(size_t Root, const wchar_t* Name, const wchar_t* Value)
+{
+  Key* key = toKey(Root);
+  auto it = key->values.find(Name);
+  if (it == key->values.end() || it->second.type != FST_STRING || it->second.string != Value) {
+    setValue(Root, Name, FST_STRING)->string = Value;
+  }
+}
+
+void SettingsCache::Set(size_t Root, const wchar_t* Name, unsigned __int64 Value)
+{
+  Key* key = toKey(Root);
+  auto it = key->values.find(Name);
+  if (it == key->values.end() || it->second.type != FST_QWORD || it->second.number != Value) {
+    setValue(Root, Name, FST_QWORD)->number = Value;
+  }
+}
+
+size_t SettingsCache::rGetSubKey(size_t Root, const wchar_t* Name)
+{
+  Key* key = toKey(Root);
+  std::unique_ptr<Key> &subkey = key->subkeys[Name];
+  if (!subkey) {
+    subkey.reset(new Key());
+    subkey->parent = key;
+    subkey->name = Name;
+    subkey->changed = false;
+  }
+  return reinterpret_cast<size_t>(subkey.get());
+}
+
+size_t SettingsCache::rOpenSubKey(size_t Root, const wchar_t* Name)
+{
+  Key* key = toKey(Root);
+  auto it = key->subkeys.find(Name);
+  return it != key->subkeys.end() ? reinterpret_cast<size_t>(it->second.get()) : 0;
+}
+
+void SettingsCache::rDeleteSubKey(size_t Root, const wchar_t* Name)
+{
+  Key* key = toKey(Root);
+  if (!key->subkeys.erase(Name) && !key->values.erase(Name)) {
+    return;
+  }
+  std::vector<std::wstring> path(1, Name);
+  for (; key != &root; key = key->parent) {
+    path.push_back(key->name);
+  }
+  deletes.push_back(std::vector<std::wstring>(path.rbegin(), path.rend()));
+}
+
+const SettingsCache::Key* SettingsCache::getKey(size_t Root)
+{
+  return toKey(Root);
+}
+
+void SettingsCache::flush()
+{
+  if (!isChanged()) {
+    return;
+  }
+  SettingsControl settings;
+  // removals go first, a value set after the removal is written below
+  for (auto it = deletes.begin(); it != deletes.end(); ++it) {
+    size_t far_key = 0;
+    for (size_t i = 0; i + 1 < it->size(); i++) {
+      far_key = settings.rOpenSubKey(far_key, (*it)[i].c_str());
+      if (!far_key) {
+        break;
+      }
+    }
+    if (far_key || it->size() == 1) {
+      settings.rDeleteSubKey(far_key, it->back().c_str());
+    }
+  }
+  deletes.clear();
+  if (root.changed) {
+    writeKey(settings, 0, &root);
+  }
+}
+
+void SettingsCache::writeKey(SettingsControl &settings, size_t farKey, Key* key)
+{
+  for (auto it = key->values.begin(); it != key->values.end(); ++it) {
+    if (it->second.changed) {
+      if (it->second.type == FST_STRING) {
+        settings.Set(farKey, it->first.c_str(), it->second.string.c_str());
+      } else {
+        settings.Set(farKey, it->first.c_str(), it->second.number);
+      }
+      it->second.changed = false;
+    }
+  }
+  for (auto it = key->subkeys.begin(); it != key->subkeys.end(); ++it) {
+    if (it->second->changed) {
+      writeKey(settings, settings.rGetSubKey(farKey, it->first.c_str()), it->second.get());
+    }
+  }
+  key->changed = false;
+}
@@ -0,0 +1,88 @@
+#ifndef _SETTINGSCACHE_H_
+#define _SETTINGSCACHE_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SettingsControl.h"
+
+/** In-memory copy of the plugin settings.
+    The whole tree is read with one settings handle on the first access,
+    then the values are read from memory. Changes are kept in memory
+    until flush, which writes only the changed values.
+    Keys are addressed as in SettingsControl, 0 is the root.
+    Used only in the main thread.
+    @ingroup far_plugin
+*/
+class SettingsCache
+{
+public:
+  struct Value {
+    FARSETTINGSTYPES type;
+    std::wstring string;
+    unsigned __int64 number;
+    bool changed;
+  };
+
+  struct Key {
+    Key* parent;
+    std::wstring name;
+    std::map<std::wstring, std::unique_ptr<Key>> subkeys;
+    std::map<std::wstring, Value> values;
+    /** the key or its subkeys have changed values */
+    bool changed;
+  };
+
+  SettingsCache();
+
+  const wchar_t*   Get(size_t Root, const wchar_t *Name, const wchar_t *Default);
+  unsigned __int64 Get(size_t Root, const wchar_t *Name, unsigned __int64 Default);
+  __int64          Get(size_t Root, const wchar_t *Name, __int64 Default) { return (__int64)Get(Root,Name,(unsigned __int64)Default); }
+  int              Get(size_t Root, const wchar_t *Name, int Default)  { return (int)Get(Root,Name,(unsigned __int64)Default); }
+  unsigned int     Get(size_t Root, const wchar_t *Name, unsigned int Default) { return (unsigned int)Get(Root,Name,(unsigned __int64)Default); }
+  DWORD            Get(size_t Root, const wchar_t *Name, DWORD Default) { return (DWORD)Get(Root,Name,(unsigned __int64)Default); }
+  bool             Get(size_t Root, const wchar_t *Name, bool Default) { return Get(Root,Name,Default?1ull:0ull)?true:false; }
+
+  /** The value is marked as changed only if it differs from the stored one */
+  void Set(size_t Root, const wchar_t *Name, unsigned __int64 Value);
+  void Set(size_t Root, const wchar_t *Name, const wchar_t *Value);
+  void Set(size_t Root, const wchar_t *Name, __int64 Value) { Set(Root,Name,(unsigned __int64)Value); }
+  void Set(size_t Root, const wchar_t *Name, int Value) { Set(Root,Name,(unsigned __int64)Value); }
+  void Set(size_t Root, const wchar_t *Name, unsigned int Value) { Set(Root,Name,(unsigned __int64)Value); }
+  void Set(size_t Root, const wchar_t *Name, DWORD Value) { Set(Root,Name,(unsigned __int64)Value); }
+  void Set(size_t Root, const wchar_t *Name, bool Value) { Set(Root,Name,Value?1ull:0ull); }
+
+  /** Creates the subkey in memory, it is written with its first value */
+  size_t rGetSubKey(size_t Root, const wchar_t *Name);
+  /** @return 0 if there is no such subkey */
+  size_t rOpenSubKey(size_t Root, const wchar_t *Name);
+  /** Removes a subkey or a value */
+  void rDeleteSubKey(size_t Root, const wchar_t *Name);
+  /** Subkeys and values of the key, for enumeration */
+  const Key* getKey(size_t Root);
+
+  /** There are changes not written to the Far settings */
+  bool isChanged() const
+  {
+    return root.changed || !deletes.empty();
+  }
+  /** Writes the changes with one settings handle.
+      @throw SettingsControlException
+  */
+  void flush();
+
+private:
+  Key root;
+  bool loaded;
+  /** names of the removed subkeys and values, with the path from the root */
+  std::vector<std::vector<std::wstring>> deletes;
+
+  Key* toKey(size_t Root);
+  void load();
+  void readKey(SettingsControl &settings, size_t farKey, Key* key);
+  void writeKey(SettingsControl &settings, size_t farKey, Key* key);
+  Value* setValue(size_t Root, const wchar_t *Name, FARSETTINGSTYPES type);
+};
+
+#endif
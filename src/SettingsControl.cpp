@@ -56,6 +56,12 @@ size_t SettingsControl::rGetSubKey(size_t Root, const wchar_t* Name)
   return (size_t)Info.SettingsControl(farSettingHandle, SCTL_CREATESUBKEY, 0, &fsv);
 }
 
+size_t SettingsControl::rOpenSubKey(size_t Root, const wchar_t* Name)
+{
+  FarSettingsValue fsv = {sizeof(FarSettingsValue), Root, Name};
+  return (size_t)Info.SettingsControl(farSettingHandle, SCTL_OPENSUBKEY, 0, &fsv);
+}
+
 bool SettingsControl::rEnum(size_t Root, FarSettingsEnum* fse)
 {
   fse->Root = Root;
@@ -26,6 +26,8 @@ public:
   bool Set(size_t Root, const wchar_t *Name, bool Value) { return Set(Root,Name,Value?1ull:0ull); }
 
   size_t rGetSubKey(size_t Root, const wchar_t *Name);
+  /** @return 0 if there is no such subkey */
+  size_t rOpenSubKey(size_t Root, const wchar_t *Name);
   bool rEnum(size_t Root, FarSettingsEnum *fse);
   bool rDeleteSubKey(size_t Root,const wchar_t *Name);
 
@@ -0,0 +1,19 @@
+#include "SyncErrorHandler.h"
+
+void SyncErrorHandler::fatalError(const String &msg)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  handler->fatalError(msg);
+}
+
+void SyncErrorHandler::error(const String &msg)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  handler->error(msg);
+}
+
+void SyncErrorHandler::warning(const String &msg)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  handler->warning(msg);
+}
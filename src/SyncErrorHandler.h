@@ -0,0 +1,26 @@
+#ifndef _SYNCERRORHANDLER_H_
+#define _SYNCERRORHANDLER_H_
+
+#include <memory>
+#include <mutex>
+#include <colorer/handlers/FileErrorHandler.h>
+
+/** Passes the messages of several threads to one handler.
+    @ingroup far_plugin
+*/
+class SyncErrorHandler : public colorer::ErrorHandler
+{
+public:
+  SyncErrorHandler(colorer::ErrorHandler* eh): handler(eh) {}
+  /** Takes the handler, it lives as long as this one */
+  SyncErrorHandler(std::unique_ptr<colorer::ErrorHandler> eh): handler(eh.get()), owned(std::move(eh)) {}
+  void fatalError(const String &msg);
+  void error(const String &msg);
+  void warning(const String &msg);
+private:
+  colorer::ErrorHandler* handler;
+  std::unique_ptr<colorer::ErrorHandler> owned;
+  std::mutex lock;
+};
+
+#endif
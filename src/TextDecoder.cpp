@@ -0,0 +1,209 @@
+#include "TextDecoder.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TEXT_DECODER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef TEXT_DECODER_SSE2
+/** 32-bit builds can run on the processors without SSE2 */
+static bool hasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+  return true;
+#else
+  static const bool sse2 = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) != 0;
+  return sse2;
+#endif
+}
+#endif
+
+size_t detectBom(const char* data, size_t size, TextEncoding &encoding)
+{
+  if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+    encoding = TE_UTF8;
+    return 3;
+  }
+  if (size >= 2 && memcmp(data, "\xFF\xFE", 2) == 0) {
+    encoding = TE_UTF16LE;
+    return 2;
+  }
+  if (size >= 2 && memcmp(data, "\xFE\xFF", 2) == 0) {
+    encoding = TE_UTF16BE;
+    return 2;
+  }
+  encoding = TE_ANSI;
+  return 0;
+}
+
+/** Widens ASCII bytes while they are ASCII, by 16 bytes.
+    @return number of the converted bytes
+*/
+static size_t widenAscii(const unsigned char* data, size_t size, wchar_t* out)
+{
+  size_t i = 0;
+#ifdef TEXT_DECODER_SSE2
+  if (hasSse2()) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+      __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      if (_mm_movemask_epi8(bytes)) {
+        break;
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(bytes, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+    }
+  }
+#endif
+  for (; i < size && data[i] < 0x80; i++) {
+    out[i] = data[i];
+  }
+  return i;
+}
+
+/** Decodes UTF-8 by code points between the ASCII runs.
+    @return false if the text isn't valid UTF-8
+*/
+static bool decodeUtf8(const unsigned char* data, size_t size, std::vector<wchar_t> &text)
+{
+  // UTF-16 text is never longer than UTF-8 one
+  text.resize(size);
+  wchar_t* out = text.data();
+  size_t i = 0;
+  while (i < size) {
+    size_t ascii = widenAscii(data + i, size - i, out);
+    i += ascii;
+    out += ascii;
+    if (i == size) {
+      break;
+    }
+
+    unsigned int c = data[i];
+    unsigned int cp;
+    size_t len;
+    if (c >= 0xC2 && c <= 0xDF) {
+      cp = c & 0x1F;
+      len = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+      cp = c & 0x0F;
+      len = 3;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+      cp = c & 0x07;
+      len = 4;
+    } else {
+      return false;
+    }
+    if (i + len > size) {
+      return false;
+    }
+    for (size_t k = 1; k < len; k++) {
+      if ((data[i + k] & 0xC0) != 0x80) {
+        return false;
+      }
+      cp = (cp << 6) | (data[i + k] & 0x3F);
+    }
+    // overlong forms, surrogates and code points after U+10FFFF
+    if ((len == 3 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))) || (len == 4 && (cp < 0x10000 || cp > 0x10FFFF))) {
+      return false;
+    }
+    if (cp >= 0x10000) {
+      cp -= 0x10000;
+      *out++ = static_cast<wchar_t>(0xD800 + (cp >> 10));
+      *out++ = static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+    } else {
+      *out++ = static_cast<wchar_t>(cp);
+    }
+    i += len;
+  }
+  text.resize(out - text.data());
+  return true;
+}
+
+static void decodeUtf16(bool bigEndian, const char* data, size_t size, std::vector<wchar_t> &text)
+{
+  size_t count = size / 2;
+  text.resize(count);
+  if (!bigEndian) {
+    memcpy(text.data(), data, count * 2);
+    return;
+  }
+  size_t i = 0;
+#ifdef TEXT_DECODER_SSE2
+  if (hasSse2()) {
+    for (; i + 8 <= count; i += 8) {
+      __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2));
+      units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(text.data() + i), units);
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    text[i] = static_cast<wchar_t>((static_cast<unsigned char>(data[i * 2]) << 8) | static_cast<unsigned char>(data[i * 2 + 1]));
+  }
+}
+
+static void decodeSystem(UINT cp, const char* data, size_t size, std::vector<wchar_t> &text)
+{
+  int len = size ? MultiByteToWideChar(cp, 0, data, static_cast<int>(size), nullptr, 0) : 0;
+  text.resize(len);
+  if (len) {
+    MultiByteToWideChar(cp, 0, data, static_cast<int>(size), text.data(), len);
+  }
+}
+
+void decodeText(TextEncoding encoding, const char* data, size_t size, std::vector<wchar_t> &text)
+{
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  switch (encoding) {
+    case TE_UTF16LE:
+    case TE_UTF16BE:
+      decodeUtf16(encoding == TE_UTF16BE, data, size, text);
+      break;
+    case TE_UTF8:
+      if (!decodeUtf8(bytes, size, text)) {
+        // invalid sequences are replaced as before
+        decodeSystem(CP_UTF8, data, size, text);
+      }
+      break;
+    default:
+      // ASCII is the same in all ANSI code pages
+      text.resize(size);
+      if (widenAscii(bytes, size, text.data()) != size) {
+        decodeSystem(CP_ACP, data, size, text);
+      }
+  }
+}
+
+const char* findLineFeed(TextEncoding encoding, const char* start, const char* end)
+{
+  if (encoding != TE_UTF16LE && encoding != TE_UTF16BE) {
+    return static_cast<const char*>(memchr(start, '\n', end - start));
+  }
+  const unsigned short lf = encoding == TE_UTF16LE ? 0x000A : 0x0A00;
+  const char* p = start;
+#ifdef TEXT_DECODER_SSE2
+  if (hasSse2()) {
+    const __m128i lfs = _mm_set1_epi16(static_cast<short>(lf));
+    for (; p + 16 <= end; p += 16) {
+      __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(units, lfs));
+      if (mask) {
+        int bit = 0;
+        while (!(mask & 1)) {
+          mask >>= 1;
+          bit++;
+        }
+        return p + bit;
+      }
+    }
+  }
+#endif
+  for (; p + 1 < end; p += 2) {
+    unsigned short unit;
+    memcpy(&unit, p, 2);
+    if (unit == lf) {
+      return p;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,30 @@
+#ifndef _TEXTDECODER_H_
+#define _TEXTDECODER_H_
+
+#include <vector>
+#include "pcolorer.h"
+
+/*
+  Decoding of the file text to UTF-16.
+  ASCII parts and UTF-16 are converted by 16 bytes with SSE2,
+  if the processor has it. Other characters are decoded one by one,
+  invalid UTF-8 and ANSI text are decoded by the system.
+*/
+
+/** Encoding of the file text */
+enum TextEncoding { TE_ANSI, TE_UTF8, TE_UTF16LE, TE_UTF16BE };
+
+/** Detects encoding by BOM.
+    @return size of BOM, 0 if there is no BOM and the text is ANSI
+*/
+size_t detectBom(const char* data, size_t size, TextEncoding &encoding);
+
+/** Decodes the text, size is in bytes */
+void decodeText(TextEncoding encoding, const char* data, size_t size, std::vector<wchar_t> &text);
+
+/** Returns position of the next line feed, or nullptr.
+    UTF-16 text should start at an even offset.
+*/
+const char* findLineFeed(TextEncoding encoding, const char* start, const char* end);
+
+#endif
@@ -0,0 +1,249 @@
+#include "TokenStream.h"
+
+TokenStreamWriter::TokenStreamWriter()
+{
+  lineOffsets.push_back(0);
+}
+
+unsigned int TokenStreamWriter::getRegionId(const Region* region)
+{
+  if (region == nullptr) {
+    return 0;
+  }
+  auto it = regionIds.find(region);
+  if (it != regionIds.end()) {
+    return it->second;
+  }
+  regions.push_back(region);
+  unsigned int id = static_cast<unsigned int>(regions.size());
+  regionIds[region] = id;
+  return id;
+}
+
+void TokenStreamWriter::writeNumber(unsigned int value)
+{
+  while (value >= 0x80) {
+    runs.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+  }
+  runs.push_back(static_cast<unsigned char>(value));
+}
+
+void TokenStreamWriter::addLine(int lineLength, LineRegion* lineRegions)
+{
+  lineIds.assign(lineLength, 0);
+  // the later regions of the list are nested
+  for (LineRegion* l1 = lineRegions; l1; l1 = l1->next) {
+    if (l1->special || l1->region == nullptr || l1->start == l1->end) {
+      continue;
+    }
+    unsigned int id = getRegionId(l1->region);
+    int end = (l1->end == -1 || l1->end > lineLength) ? lineLength : l1->end;
+    for (int i = l1->start; i < end; i++) {
+      lineIds[i] = id;
+    }
+  }
+
+  for (int start = 0; start < lineLength;) {
+    int end = start + 1;
+    while (end < lineLength && lineIds[end] == lineIds[start]) {
+      end++;
+    }
+    writeNumber(lineIds[start]);
+    writeNumber(end - start);
+    start = end;
+  }
+  lineOffsets.push_back(runs.size());
+}
+
+void TokenStreamWriter::save(const String* fileName)
+{
+  TokenStreamHeader header;
+  header.magic = TOKEN_STREAM_MAGIC;
+  header.version = TOKEN_STREAM_VERSION;
+  header.lineCount = static_cast<unsigned int>(lineOffsets.size() - 1);
+  header.regionCount = static_cast<unsigned int>(regions.size());
+  header.runsOffset = sizeof(TokenStreamHeader);
+  header.lineTableOffset = header.runsOffset + runs.size();
+  header.regionTableOffset = header.lineTableOffset + lineOffsets.size() * sizeof(unsigned __int64);
+
+  std::vector<char> names;
+  for (auto it = regions.begin(); it != regions.end(); ++it) {
+    const String* name = (*it)->getName();
+    unsigned int len = name ? name->length() : 0;
+    size_t pos = names.size();
+    names.resize(pos + sizeof(len) + len * sizeof(wchar_t));
+    memcpy(&names[pos], &len, sizeof(len));
+    for (unsigned int i = 0; i < len; i++) {
+      wchar_t c = (*name)[i];
+      memcpy(&names[pos + sizeof(len) + i * sizeof(wchar_t)], &c, sizeof(wchar_t));
+    }
+  }
+
+  HANDLE out = CreateFileW(fileName->getWChars(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (out == INVALID_HANDLE_VALUE) {
+    StringBuffer msg("Can't create file: ");
+    msg.append(fileName);
+    throw Exception(msg);
+  }
+  DWORD written = 0;
+  bool res = WriteFile(out, &header, sizeof(header), &written, nullptr) && written == sizeof(header);
+  if (res && !runs.empty()) {
+    res = WriteFile(out, runs.data(), static_cast<DWORD>(runs.size()), &written, nullptr) && written == runs.size();
+  }
+  if (res) {
+    DWORD size = static_cast<DWORD>(lineOffsets.size() * sizeof(unsigned __int64));
+    res = WriteFile(out, lineOffsets.data(), size, &written, nullptr) && written == size;
+  }
+  if (res && !names.empty()) {
+    res = WriteFile(out, names.data(), static_cast<DWORD>(names.size()), &written, nullptr) && written == names.size();
+  }
+  CloseHandle(out);
+  if (!res) {
+    DeleteFileW(fileName->getWChars());
+    StringBuffer msg("Can't write file: ");
+    msg.append(fileName);
+    throw Exception(msg);
+  }
+}
+
+TokenStreamReader::TokenStreamReader() :
+  file(INVALID_HANDLE_VALUE), mapping(nullptr), view(nullptr), viewSize(0)
+{
+  memset(&header, 0, sizeof(header));
+}
+
+TokenStreamReader::~TokenStreamReader()
+{
+  close();
+}
+
+void TokenStreamReader::close()
+{
+  if (view) {
+    UnmapViewOfFile(view);
+    view = nullptr;
+  }
+  if (mapping) {
+    CloseHandle(mapping);
+    mapping = nullptr;
+  }
+  if (file != INVALID_HANDLE_VALUE) {
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+  }
+  viewSize = 0;
+  names.clear();
+  memset(&header, 0, sizeof(header));
+}
+
+bool TokenStreamReader::open(const String* fileName)
+{
+  close();
+  file = CreateFileW(fileName->getWChars(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(TokenStreamHeader)) {
+    close();
+    return false;
+  }
+  mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping) {
+    view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (!view) {
+    close();
+    return false;
+  }
+  viewSize = static_cast<size_t>(size.QuadPart);
+
+  TokenStreamHeader h;
+  memcpy(&h, view, sizeof(h));
+  // all the tables must lie in the mapped file, in the order of the format
+  if (h.magic != TOKEN_STREAM_MAGIC || h.version != TOKEN_STREAM_VERSION || h.runsOffset < sizeof(TokenStreamHeader) ||
+      h.lineTableOffset < h.runsOffset || h.regionTableOffset > viewSize || h.lineTableOffset > h.regionTableOffset ||
+      (static_cast<unsigned __int64>(h.lineCount) + 1) > (h.regionTableOffset - h.lineTableOffset) / sizeof(unsigned __int64)) {
+    close();
+    return false;
+  }
+
+  size_t pos = static_cast<size_t>(h.regionTableOffset);
+  for (unsigned int i = 0; i < h.regionCount; i++) {
+    unsigned int len;
+    if (pos + sizeof(len) > viewSize) {
+      close();
+      return false;
+    }
+    memcpy(&len, view + pos, sizeof(len));
+    pos += sizeof(len);
+    if (len > (viewSize - pos) / sizeof(wchar_t)) {
+      close();
+      return false;
+    }
+    Name name = { reinterpret_cast<const wchar_t*>(view + pos), static_cast<int>(len) };
+    names.push_back(name);
+    pos += len * sizeof(wchar_t);
+  }
+  header = h;
+  return true;
+}
+
+DString TokenStreamReader::getRegionName(unsigned int id) const
+{
+  if (id == 0 || id > names.size()) {
+    return DString("");
+  }
+  return DString(names[id - 1].name, 0, names[id - 1].length);
+}
+
+bool TokenStreamReader::getLineRuns(size_t lno, std::vector<Run> &lineRuns) const
+{
+  lineRuns.clear();
+  if (lno >= header.lineCount) {
+    return false;
+  }
+  unsigned __int64 offsets[2];
+  memcpy(offsets, view + header.lineTableOffset + lno * sizeof(unsigned __int64), sizeof(offsets));
+  // the runs of the line must lie before the line table
+  if (offsets[0] > offsets[1] || offsets[1] > header.lineTableOffset - header.runsOffset) {
+    return false;
+  }
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(view + header.runsOffset + offsets[0]);
+  const unsigned char* end = reinterpret_cast<const unsigned char*>(view + header.runsOffset + offsets[1]);
+
+  while (p < end) {
+    unsigned int value[2];
+    for (int k = 0; k < 2; k++) {
+      if (!readNumber(p, end, value[k])) {
+        lineRuns.clear();
+        return false;
+      }
+    }
+    Run run = { value[0], value[1] };
+    lineRuns.push_back(run);
+  }
+  return true;
+}
+
+bool TokenStreamReader::readNumber(const unsigned char* &p, const unsigned char* end, unsigned int &value)
+{
+  value = 0;
+  for (int shift = 0; p < end; shift += 7) {
+    // an unsigned int takes five bytes at most, the fifth one has four bits
+    if (shift >= 32) {
+      return false;
+    }
+    unsigned char b = *p++;
+    if (shift == 28 && (b & 0x70)) {
+      return false;
+    }
+    value |= static_cast<unsigned int>(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  // the number is cut by the end of the line runs
+  return false;
+}
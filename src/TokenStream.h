@@ -0,0 +1,107 @@
+#ifndef _TOKENSTREAM_H_
+#define _TOKENSTREAM_H_
+
+#include <unordered_map>
+#include <vector>
+#include <colorer/editor/BaseEditor.h>
+#include "pcolorer.h"
+
+/*
+  Token stream file - the regions of the parsed text.
+
+  TokenStreamHeader
+  runs         - for each line the runs of characters with the same innermost
+                 region: region id and length, both as unsigned LEB128 numbers.
+                 Region id 0 - no region. The lengths count the characters
+                 of the text, the tabs are not expanded.
+  line table   - lineCount + 1 offsets of the line runs (unsigned __int64),
+                 from runsOffset. The last one is the end of runs.
+  region table - for each region id from 1: name length (unsigned int) and
+                 the name in UTF-16.
+*/
+const unsigned int TOKEN_STREAM_MAGIC = 0x534B5443; // "CTKS"
+const unsigned int TOKEN_STREAM_VERSION = 1;
+
+struct TokenStreamHeader {
+  unsigned int magic;
+  unsigned int version;
+  unsigned int lineCount;
+  unsigned int regionCount;
+  unsigned __int64 runsOffset;
+  unsigned __int64 lineTableOffset;
+  unsigned __int64 regionTableOffset;
+};
+
+/** Writes the regions of the parsed lines in the token stream format.
+    @ingroup far_plugin
+*/
+class TokenStreamWriter
+{
+public:
+  TokenStreamWriter();
+
+  /** Appends the next line of the text */
+  void addLine(int lineLength, LineRegion* lineRegions);
+  /** @throw Exception if the file can't be written */
+  void save(const String* fileName);
+
+private:
+  std::unordered_map<const Region*, unsigned int> regionIds;
+  std::vector<const Region*> regions;
+  std::vector<unsigned __int64> lineOffsets;
+  std::vector<unsigned char> runs;
+  /** innermost region of each character of the line */
+  std::vector<unsigned int> lineIds;
+
+  unsigned int getRegionId(const Region* region);
+  void writeNumber(unsigned int value);
+};
+
+/** Reads the token stream file through the file mapping.
+    @ingroup far_plugin
+*/
+class TokenStreamReader
+{
+public:
+  struct Run {
+    unsigned int region;
+    unsigned int length;
+  };
+
+  TokenStreamReader();
+  ~TokenStreamReader();
+
+  /** @return false if the file can't be read or has another format */
+  bool open(const String* fileName);
+  void close();
+
+  size_t getLineCount() const
+  {
+    return header.lineCount;
+  }
+  size_t getRegionCount() const
+  {
+    return header.regionCount;
+  }
+  /** Name of the region with id from 1 to getRegionCount(). Valid while the file is open. */
+  DString getRegionName(unsigned int id) const;
+  /** Decodes the runs of the line. @return false if the line is out of range or its runs are broken */
+  bool getLineRuns(size_t lno, std::vector<Run> &lineRuns) const;
+
+private:
+  HANDLE file;
+  HANDLE mapping;
+  const char* view;
+  size_t viewSize;
+  TokenStreamHeader header;
+  struct Name {
+    const wchar_t* name;
+    int length;
+  };
+  std::vector<Name> names;
+
+  /** Decodes an unsigned LEB128 number. @return false if it is cut or longer than an unsigned int */
+  static bool readNumber(const unsigned char* &p, const unsigned char* end, unsigned int &value);
+};
+
+#endif
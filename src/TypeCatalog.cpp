@@ -0,0 +1,143 @@
+#include <string>
+#include <unordered_map>
+#include "TypeCatalog.h"
+
+TypeCatalog::TypeCatalog() : hrcParser(nullptr), built(false)
+{
+  memset(&list, 0, sizeof(list));
+}
+
+void TypeCatalog::reset(HRCParser* parser)
+{
+  hrcParser = parser;
+  built = false;
+  types.clear();
+  groups.clear();
+  listItems.clear();
+  listTypes.clear();
+  labels.reset();
+  matcher.clear();
+  typeIndex.clear();
+}
+
+const std::vector<FileType*> &TypeCatalog::getTypes()
+{
+  if (!built) {
+    build();
+  }
+  return types;
+}
+
+const std::vector<TypeCatalog::Group> &TypeCatalog::getGroups()
+{
+  if (!built) {
+    build();
+  }
+  return groups;
+}
+
+FarList* TypeCatalog::getList()
+{
+  if (!built) {
+    build();
+  }
+  list.StructSize = sizeof(FarList);
+  list.Items = listItems.data();
+  list.ItemsNumber = listItems.size();
+  return &list;
+}
+
+FileType* TypeCatalog::getListType(size_t index)
+{
+  if (!built) {
+    build();
+  }
+  return index < listTypes.size() ? listTypes[index] : nullptr;
+}
+
+FuzzyMatcher &TypeCatalog::getMatcher()
+{
+  if (!built) {
+    build();
+  }
+  return matcher;
+}
+
+size_t TypeCatalog::getTypeIndex(const FileType* type)
+{
+  if (!built) {
+    build();
+  }
+  auto it = typeIndex.find(type);
+  return it != typeIndex.end() ? it->second : SIZE_MAX;
+}
+
+void TypeCatalog::build()
+{
+  built = true;
+  if (hrcParser == nullptr) {
+    return;
+  }
+
+  // types of each group in the order of the database
+  std::vector<std::vector<FileType*>> group_types;
+  std::vector<const String*> group_names;
+  std::unordered_map<std::wstring, size_t> group_index;
+  FileType* type;
+  for (int idx = 0; (type = hrcParser->enumerateFileTypes(idx)) != nullptr; idx++) {
+    const String* group = type->getGroup();
+    std::wstring key = group != nullptr ? std::wstring(group->getWChars()) : std::wstring();
+    auto it = group_index.find(key);
+    if (it == group_index.end()) {
+      it = group_index.insert(std::make_pair(key, group_types.size())).first;
+      group_types.push_back(std::vector<FileType*>());
+      group_names.push_back(group);
+    }
+    group_types[it->second].push_back(type);
+  }
+
+  for (size_t g = 0; g < group_types.size(); g++) {
+    Group group = { group_names[g], types.size() };
+    groups.push_back(group);
+    types.insert(types.end(), group_types[g].begin(), group_types[g].end());
+  }
+
+  listItems.reserve(types.size() + groups.size());
+  listTypes.reserve(types.size() + groups.size());
+  for (size_t g = 0; g < groups.size(); g++) {
+    FarListItem item;
+    memset(&item, 0, sizeof(item));
+    if (g > 0) {
+      item.Flags = LIF_SEPARATOR;
+      listItems.push_back(item);
+      listTypes.push_back(nullptr);
+    }
+
+    const wchar_t* group_chars = groups[g].name != nullptr ? groups[g].name->getWChars() : L"<no group>";
+    size_t end = g + 1 < groups.size() ? groups[g + 1].start : types.size();
+    for (size_t i = groups[g].start; i < end; i++) {
+      wchar_t* label = labels.alloc(255);
+      _snwprintf(label, 255, L"%s: %s", group_chars, types[i]->getDescription()->getWChars());
+      label[254] = 0;
+      item.Flags = 0;
+      item.Text = label;
+      listItems.push_back(item);
+      listTypes.push_back(types[i]);
+    }
+  }
+  if (!listItems.empty()) {
+    listItems[0].Flags = LIF_SELECTED;
+  }
+
+  typeIndex.reserve(types.size());
+  for (size_t i = 0; i < types.size(); i++) {
+    StringBuffer search;
+    search.append(types[i]->getName());
+    search.append(DString(" ")).append(types[i]->getDescription());
+    if (types[i]->getGroup() != nullptr) {
+      search.append(DString(" ")).append(types[i]->getGroup());
+    }
+    matcher.add(&search);
+    typeIndex[types[i]] = i;
+  }
+}
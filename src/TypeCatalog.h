@@ -0,0 +1,69 @@
+#ifndef _TYPECATALOG_H_
+#define _TYPECATALOG_H_
+
+#include <unordered_map>
+#include <vector>
+#include <colorer/HRCParser.h>
+#include "pcolorer.h"
+#include "MenuArena.h"
+#include "FuzzyMatcher.h"
+
+/** File types of the database in the order they are shown, built once
+    after the database is loaded. Types of a group go one after another,
+    the groups in the order of their first types in the database.
+    The list of the HRC settings dialog is kept with its labels, and
+    the search index of the types for the type menu filter.
+    @ingroup far_plugin
+*/
+class TypeCatalog
+{
+public:
+  struct Group {
+    /** group name, nullptr if the types have no group */
+    const String* name;
+    /** index of the first type of the group */
+    size_t start;
+  };
+
+  TypeCatalog();
+
+  /** Drops the catalog, it is built from the new database on the next access.
+      @param parser the database, or nullptr
+  */
+  void reset(HRCParser* parser);
+
+  const std::vector<FileType*> &getTypes();
+  /** Groups in the order of types, the end of a group is the start of the next one */
+  const std::vector<Group> &getGroups();
+
+  /** Items of the type list of the HRC settings dialog, "group: description",
+      with a separator between the groups. The list is valid until reset.
+  */
+  FarList* getList();
+  /** Type of the item of the dialog list, nullptr for a separator */
+  FileType* getListType(size_t index);
+
+  /** Search index of "name description group" of each type, in the order of getTypes */
+  FuzzyMatcher &getMatcher();
+  /** Index of the type in getTypes and in the matcher */
+  size_t getTypeIndex(const FileType* type);
+
+private:
+  HRCParser* hrcParser;
+  bool built;
+  std::vector<FileType*> types;
+  std::vector<Group> groups;
+
+  std::vector<FarListItem> listItems;
+  /** type of each item of listItems */
+  std::vector<FileType*> listTypes;
+  FarList list;
+  MenuArena labels;
+
+  FuzzyMatcher matcher;
+  std::unordered_map<const FileType*, size_t> typeIndex;
+
+  void build();
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <chrono>
+#include "TypeLoader.h"
+#include "BaseLoader.h"
+
+TypeLoader::TypeLoader(const String* catalogPath_, const String* userHrcPath_, colorer::ErrorHandler* eh) :
+  catalogPath(nullptr), userHrcPath(nullptr), errorHandler(eh), syncErrorHandler(eh),
+  nextType(0), loadedCount(0), finishedWorkers(0), stop(false), error(nullptr), sorted(false), elapsed(0)
+{
+  if (catalogPath_) {
+    catalogPath.reset(new SString(*catalogPath_));
+  }
+  if (userHrcPath_ && userHrcPath_->length()) {
+    userHrcPath.reset(new SString(*userHrcPath_));
+  }
+}
+
+TypeLoader::~TypeLoader()
+{
+  stop = true;
+  join();
+}
+
+void TypeLoader::start(HRCParser* hrcParser, size_t threads)
+{
+  for (int idx = 0;; idx++) {
+    FileType* type = hrcParser->enumerateFileTypes(idx);
+    if (type == nullptr) {
+      break;
+    }
+
+    TypeTime tt;
+    tt.name.reset(new SString(*type->getName()));
+    StringBuffer tname;
+    if (type->getGroup() != nullptr) {
+      tname.append(type->getGroup());
+      tname.append(DString(": "));
+    }
+    tname.append(type->getDescription());
+    tt.title.reset(new SString(tname));
+    tt.time = 0;
+    types.push_back(std::move(tt));
+  }
+
+  if (threads > types.size()) {
+    threads = types.size();
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  startTime = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back(&TypeLoader::worker, this);
+  }
+}
+
+bool TypeLoader::wait(unsigned int timeout_ms)
+{
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (finishedWorkers < workers.size()) {
+    if (std::chrono::steady_clock::now() >= end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  join();
+  elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+  return true;
+}
+
+void TypeLoader::join()
+{
+  for (auto it = workers.begin(); it != workers.end(); ++it) {
+    if (it->joinable()) {
+      it->join();
+    }
+  }
+}
+
+const std::vector<TypeLoader::TypeTime> &TypeLoader::getTimes()
+{
+  if (!sorted) {
+    std::stable_sort(types.begin(), types.end(), [](const TypeTime & a, const TypeTime & b) {
+      return a.time > b.time;
+    });
+    sorted = true;
+  }
+  return types;
+}
+
+void TypeLoader::worker()
+{
+  try {
+    ParserFactory pf(errorHandler ? &syncErrorHandler : nullptr);
+    loadBase(&pf, catalogPath.get(), userHrcPath.get());
+    HRCParser* hrcParser = pf.getHRCParser();
+
+    while (!stop) {
+      size_t idx = nextType++;
+      if (idx >= types.size()) {
+        break;
+      }
+
+      FileType* type = hrcParser->getFileType(types[idx].name.get());
+      auto t0 = std::chrono::steady_clock::now();
+      if (type != nullptr) {
+        type->getBaseScheme();
+      }
+      types[idx].time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+      loadedCount++;
+    }
+  } catch (Exception &e) {
+    setError(e.getMessage());
+    stop = true;
+  } catch (std::exception &e) {
+    // an exception must not leave the thread
+    DString msg(e.what());
+    setError(&msg);
+    stop = true;
+  } catch (...) {
+    DString msg("Unknown error while loading file types");
+    setError(&msg);
+    stop = true;
+  }
+  finishedWorkers++;
+}
+
+void TypeLoader::setError(const String* msg)
+{
+  std::lock_guard<std::mutex> guard(errorLock);
+  if (error == nullptr) {
+    error.reset(new SString(*msg));
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef _TYPELOADER_H_
+#define _TYPELOADER_H_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <colorer/ParserFactory.h>
+#include <colorer/handlers/FileErrorHandler.h>
+#include "pcolorer.h"
+#include "SyncErrorHandler.h"
+
+/** Loads schemes of all file types of the catalog on several threads.
+    HRCParser is not thread safe, so each thread has its own
+    ParserFactory and takes the next type from the shared list.
+    Load time of each type is measured, it includes the time
+    of the types loaded by this one for the first time.
+    @ingroup far_plugin
+*/
+class TypeLoader
+{
+public:
+  struct TypeTime {
+    std::unique_ptr<SString> name;
+    std::unique_ptr<SString> title;
+    /** load time in milliseconds */
+    double time;
+  };
+
+  TypeLoader(const String* catalogPath, const String* userHrcPath, colorer::ErrorHandler* eh);
+  /** Stops loading and waits for the threads */
+  ~TypeLoader();
+
+  /** Starts loading of the file types listed in hrcParser */
+  void start(HRCParser* hrcParser, size_t threads);
+  /** Waits for the end of loading.
+      @return false if the loading isn't finished after timeout
+  */
+  bool wait(unsigned int timeout_ms);
+
+  size_t count() const
+  {
+    return types.size();
+  }
+  size_t loaded() const
+  {
+    return loadedCount;
+  }
+  /** The first error of loading, or nullptr */
+  const String* getError() const
+  {
+    return error.get();
+  }
+  /** Load times, the slowest types first. Valid after the end of loading. */
+  const std::vector<TypeTime> &getTimes();
+  /** Wall-clock time from the start to the end of loading, in milliseconds */
+  double getElapsed() const
+  {
+    return elapsed;
+  }
+
+private:
+  std::unique_ptr<SString> catalogPath;
+  std::unique_ptr<SString> userHrcPath;
+  colorer::ErrorHandler* errorHandler;
+  SyncErrorHandler syncErrorHandler;
+
+  std::vector<TypeTime> types;
+  std::vector<std::thread> workers;
+  std::atomic<size_t> nextType;
+  std::atomic<size_t> loadedCount;
+  std::atomic<size_t> finishedWorkers;
+  std::atomic<bool> stop;
+  std::mutex errorLock;
+  std::unique_ptr<SString> error;
+  bool sorted;
+  std::chrono::steady_clock::time_point startTime;
+  double elapsed;
+
+  void worker();
+  void join();
+  void setError(const String* msg);
+};
+
+#endif
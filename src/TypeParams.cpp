@@ -0,0 +1,80 @@
+#include "TypeParams.h"
+#include "FarEditor.h"
+
+namespace
+{
+struct ParamInfo {
+  const DString* name;
+  /** the value is taken from the default type, if the type has no value */
+  bool inherited;
+  int defaultNumber;
+};
+
+const ParamInfo paramInfo[TP_COUNT] = {
+  { &DBackparse, true, 2000 },
+  { &DMaxLen, true, 0 },
+  { &DDefFore, true, -1 },
+  { &DDefBack, true, -1 },
+  { &DFullback, true, 0 },
+  { &DCrossZorder, true, 0 },
+  { &DShowCross, true, 0 },
+  { &DFirstLines, true, 4 },
+  { &DFirstLineBytes, true, 800 },
+  { &DHotkey, false, 0 },
+  { &DFavorite, false, 0 }
+};
+}
+
+TypeParams::TypeParams() : defaultType(nullptr)
+{
+}
+
+void TypeParams::reset(FileType* defType)
+{
+  types.clear();
+  defaultType = defType;
+}
+
+void TypeParams::invalidate(FileType* type)
+{
+  // values of all types may come from the default one
+  if (type == defaultType) {
+    types.clear();
+  } else {
+    types.erase(type);
+  }
+}
+
+const String* TypeParams::getValue(FileType* type, TypeParam param)
+{
+  return resolve(type).strings[param];
+}
+
+int TypeParams::getValueInt(FileType* type, TypeParam param)
+{
+  return resolve(type).numbers[param];
+}
+
+const TypeParams::Values &TypeParams::resolve(FileType* type)
+{
+  auto it = types.find(type);
+  if (it != types.end()) {
+    return it->second;
+  }
+
+  Values &values = types[type];
+  for (int i = 0; i < TP_COUNT; i++) {
+    const ParamInfo &info = paramInfo[i];
+    const String* value = type->getParamValue(*info.name);
+    int number = info.defaultNumber;
+    if (info.inherited && defaultType != nullptr) {
+      if (value == nullptr) {
+        value = defaultType->getParamValue(*info.name);
+      }
+      number = defaultType->getParamValueInt(*info.name, number);
+    }
+    values.strings[i] = value;
+    values.numbers[i] = type->getParamValueInt(*info.name, number);
+  }
+  return values;
+}
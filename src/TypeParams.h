@@ -0,0 +1,62 @@
+#ifndef _TYPEPARAMS_H_
+#define _TYPEPARAMS_H_
+
+#include <unordered_map>
+#include <colorer/FileType.h>
+
+/** Parameters of the file types used by the plugin */
+enum TypeParam {
+  TP_BACKPARSE,
+  TP_MAXLINELENGTH,
+  TP_DEFAULT_FORE,
+  TP_DEFAULT_BACK,
+  TP_FULLBACK,
+  TP_CROSS_ZORDER,
+  TP_SHOW_CROSS,
+  TP_FIRSTLINES,
+  TP_FIRSTLINEBYTES,
+  TP_HOTKEY,
+  TP_FAVORITE,
+  TP_COUNT
+};
+
+/** Values of the plugin parameters of the file types, looked up by name
+    once for a type and then read by index. Most parameters not set for
+    a type are taken from the 'default' type, hotkey and favorite are not.
+    The values must be dropped when the parameters of a type change.
+    @ingroup far_plugin
+*/
+class TypeParams
+{
+public:
+  TypeParams();
+
+  /** Drops all the values, the types of the new database are used.
+      @param defType 'default' type of the database, or nullptr
+  */
+  void reset(FileType* defType);
+  /** Drops the values of the type after its parameters are changed */
+  void invalidate(FileType* type);
+
+  FileType* getDefaultType() const
+  {
+    return defaultType;
+  }
+  /** Parameter value, nullptr if it is set neither for the type nor for the default type */
+  const String* getValue(FileType* type, TypeParam param);
+  /** Numeric parameter value, or its built-in default */
+  int getValueInt(FileType* type, TypeParam param);
+
+private:
+  struct Values {
+    const String* strings[TP_COUNT];
+    int numbers[TP_COUNT];
+  };
+
+  FileType* defaultType;
+  std::unordered_map<const FileType*, Values> types;
+
+  const Values &resolve(FileType* type);
+};
+
+#endif
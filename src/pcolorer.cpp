@@ -91,6 +91,34 @@ void WINAPI ExitFARW(const struct ExitInfo* eInfo)
   delete editorSet;
 }
 
+static void WINAPI FreeMacroResult(void* CallbackData, struct FarMacroValue* Values, size_t Count)
+{
+  FarMacroCall* mc = static_cast<FarMacroCall*>(CallbackData);
+  delete[] mc->Values[0].String;
+  delete[] mc->Values;
+  delete mc;
+}
+
+/**
+  Returns string to the macro, Far frees it with the callback.
+*/
+static HANDLE MacroResultString(const wchar_t* str)
+{
+  size_t len = wcslen(str);
+  wchar_t* copy = new wchar_t[len + 1];
+  wcscpy(copy, str);
+
+  FarMacroCall* mc = new FarMacroCall;
+  mc->StructSize = sizeof(FarMacroCall);
+  mc->Count = 1;
+  mc->Values = new FarMacroValue[1];
+  mc->Values[0].Type = FMVT_STRING;
+  mc->Values[0].String = copy;
+  mc->Callback = FreeMacroResult;
+  mc->CallbackData = mc;
+  return mc;
+}
+
 /**
   Open plugin configuration of actions dialog.
 */
@@ -105,6 +133,23 @@ HANDLE WINAPI OpenW(const struct OpenInfo* oInfo)
       //file name, which we received
       const wchar_t* file = ocli->CommandLine;
 
+      // clr:-batch html|ansi <output folder> <files>
+      if (!wcsncmp(file, L"-batch ", 7)) {
+        if (!editorSet) {
+          editorSet = new FarEditorSet();
+        }
+        editorSet->colorizeFiles(file + 7);
+        break;
+      }
+      // clr:-grep [-i] [-in <regions>] [-not <regions>] <expression> <files>
+      if (!wcsncmp(file, L"-grep ", 6)) {
+        if (!editorSet) {
+          editorSet = new FarEditorSet();
+        }
+        editorSet->grepFiles(file + 6);
+        break;
+      }
+
       wchar_t* nfile = PathToFull(file, true);
       if (nfile) {
         if (!editorSet) {
@@ -175,6 +220,43 @@ HANDLE WINAPI OpenW(const struct OpenInfo* oInfo)
             }
           }
 
+          if (command->equals("profile")) {
+            StringBuffer report;
+            editorSet->getProfileReport(report);
+            return MacroResultString(report.getWChars());
+          }
+
+          if (command->equals("memory")) {
+            StringBuffer report;
+            editorSet->getMemoryReport(report);
+            return MacroResultString(report.getWChars());
+          }
+
+          if (command->equals("region")) {
+            if (area != MACROAREA_EDITOR || mi->Count < 2 || mi->Values[1].Type != FMVT_STRING) {
+              return nullptr;
+            }
+            bool forward = true;
+            if (mi->Count > 2) {
+              switch (mi->Values[2].Type) {
+              case FMVT_BOOLEAN:
+                forward = mi->Values[2].Boolean != 0;
+                break;
+              case FMVT_INTEGER:
+                forward = mi->Values[2].Integer != 0;
+                break;
+              }
+            }
+            return editorSet->findRegion(mi->Values[1].String, forward) ? INVALID_HANDLE_VALUE : nullptr;
+          }
+
+          if (command->equals("export")) {
+            if (area != MACROAREA_EDITOR || mi->Count < 2 || mi->Values[1].Type != FMVT_STRING) {
+              return nullptr;
+            }
+            return editorSet->exportTokens(mi->Values[1].String) ? INVALID_HANDLE_VALUE : nullptr;
+          }
+
         }
     }
     break;
@@ -221,6 +303,17 @@ intptr_t WINAPI ProcessEditorEventW(const struct ProcessEditorEventInfo* pInfo)
   }
 }
 
+/**
+  Finishes the background reload of HRC database in the main thread.
+*/
+intptr_t WINAPI ProcessSynchroEventW(const struct ProcessSynchroEventInfo* pInfo)
+{
+  if (pInfo->Event == SE_COMMONSYNCHRO && editorSet) {
+    editorSet->applyReloadedBase();
+  }
+  return 0;
+}
+
 intptr_t WINAPI ProcessEditorInputW(const struct ProcessEditorInputInfo* pInfo)
 {
   return editorSet->editorInput(pInfo->Rec);
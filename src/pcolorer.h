@@ -17,6 +17,8 @@ DEFINE_GUID(PluginConfig, 0x87c92249, 0x430d, 0x4334, 0xac, 0x33, 0x5, 0xe7, 0x4
 DEFINE_GUID(HrcPluginConfig, 0x497f43a, 0xa8b9, 0x4af1, 0xa3, 0xa4, 0xfa, 0x56, 0x8f, 0x45, 0x57, 0x7);
 // {C6BE56D8-A80A-4f7d-A331-A711435F2665}
 DEFINE_GUID(AssignKeyDlg, 0xc6be56d8, 0xa80a, 0x4f7d, 0xa3, 0x31, 0xa7, 0x11, 0x43, 0x5f, 0x26, 0x65);
+// {B474449D-28CF-498E-8A16-BD1263634646}
+DEFINE_GUID(RegionSearchInput, 0xb474449d, 0x28cf, 0x498e, 0x8a, 0x16, 0xbd, 0x12, 0x63, 0x63, 0x46, 0x46);
 
 // Menu Guid
 // {45453CAC-499D-4b37-82B8-0A77F7BD087C}
@@ -27,6 +29,8 @@ DEFINE_GUID(FileChooseMenu, 0x46921647, 0xdb52, 0x44ca, 0x8d, 0x8b, 0xf3, 0x4e,
 DEFINE_GUID(HrdMenu, 0x18a6f7df, 0x375d, 0x4d3d, 0x81, 0x37, 0xdc, 0x50, 0xac, 0x52, 0xb7, 0x1e);
 // {A8A298BA-AD5A-4094-8E24-F65BF38E6C1F}
 DEFINE_GUID(OutlinerMenu, 0xa8a298ba, 0xad5a, 0x4094, 0x8e, 0x24, 0xf6, 0x5b, 0xf3, 0x8e, 0x6c, 0x1f);
+// {7F337F89-D0A6-40B1-A11C-5DA7AFC3C3FF}
+DEFINE_GUID(GrepResultMenu, 0x7f337f89, 0xd0a6, 0x40b1, 0xa1, 0x1c, 0x5d, 0xa7, 0xaf, 0xc3, 0xc3, 0xff);
 
 //Message Guid
 // {0C954AC8-2B69-4c74-94C8-7AB10324A005}
@@ -37,6 +41,8 @@ DEFINE_GUID(ReloadBaseMessage, 0xdee3b49d, 0x4a55, 0x48a8, 0x9d, 0xc8, 0xd1, 0x1
 DEFINE_GUID(NothingFoundMesage, 0xab214dce, 0x450b, 0x4389, 0x9e, 0x3b, 0x53, 0x3c, 0x7a, 0x6d, 0x78, 0x6c);
 // {70656884-B7BD-4440-A8FF-6CE781C7DC6A}
 DEFINE_GUID(RegionName, 0x70656884, 0xb7bd, 0x4440, 0xa8, 0xff, 0x6c, 0xe7, 0x81, 0xc7, 0xdc, 0x6a);
+// {C038154B-078C-4107-AEED-1150E501B3B4}
+DEFINE_GUID(RegionSearchMessage, 0xc038154b, 0x078c, 0x4107, 0xae, 0xed, 0x11, 0x50, 0xe5, 0x01, 0xb3, 0xb4);
 
 
 extern PluginStartupInfo Info;
@@ -59,7 +65,10 @@ enum {
   mUserHrdFile, mUserHrcFile, mUserHrcSetting,
   mUserHrcSettingDialog, mListSyntax, mParamList, mParamValue, mAutoDetect, mFavorites,
   mKeyAssignDialogTitle, mKeyAssignTextTitle, mRegionName, mCrossText, mCrossBoth, mCrossVert, mCrossHoriz,
-  mLog
+  mLog, mLoadingTypes, mTotalLoadTime, mSlowestTypes,
+  mBatchProgress, mBatchDone, mBatchFailed,
+  mNextRegion, mPreviousRegion, mFindRegion, mFindRegionName, mRegionSearchProgress,
+  mGrepProgress, mGrepTotal, mMemoryBudget
 };
 
 #endif
@@ -93,6 +93,25 @@ SString* PathToFullS(const wchar_t* path, bool unc)
   return spath;
 }
 
+/**
+  Reads the pending console input and checks if Esc was pressed.
+  Used to break long operations between their steps.
+*/
+bool CheckForEsc()
+{
+  HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+  bool esc = false;
+  INPUT_RECORD rec;
+  DWORD read;
+  while (PeekConsoleInputW(input, &rec, 1, &read) && read) {
+    ReadConsoleInputW(input, &rec, 1, &read);
+    if (rec.EventType == KEY_EVENT && rec.Event.KeyEvent.bKeyDown && rec.Event.KeyEvent.wVirtualKeyCode == VK_ESCAPE) {
+      esc = true;
+    }
+  }
+  return esc;
+}
+
 /* ***** BEGIN LICENSE BLOCK *****
  * Version: MPL 1.1/GPL 2.0/LGPL 2.1
  *
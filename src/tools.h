@@ -10,6 +10,8 @@ wchar_t* trim(wchar_t* str);
 wchar_t* PathToFull(const wchar_t* path, bool unc);
 SString* PathToFullS(const wchar_t* path, bool unc);
 
+bool CheckForEsc();
+
 #endif
 
 